@@ -0,0 +1,347 @@
+// ac_bench: front-end and code generation throughput on generated programs.
+//
+// For each requested size it generates a program (see generator.hpp), then
+// times each phase of the compiler on it separately and prints the results as
+// JSON on stdout. Progress goes to stderr. Every phase is run --repeat times
+// and the fastest run is reported, which filters out most scheduling noise.
+//
+//   ac_bench --size=1M --size=16M -O2 > results.json
+//   ac_bench --generate=big.athx --size=1G
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "codegen.hpp"
+#include "simplify.hpp"
+#include "generator.hpp"
+#include "lexer.hpp"
+#include "options.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+
+struct BenchOptions {
+    std::vector<uint64_t> sizes;
+    uint64_t seed = 1;
+    int repeat = 3;
+    // Code generation needs memory roughly proportional to the IR, which gets
+    // impractical long before lexing and parsing do.
+    uint64_t codegenLimit = 64ull * 1024 * 1024;
+    std::string generateOnly; // --generate=<file>
+    bool keepInputs = false;
+    CompileOptions compile;
+};
+
+void printBenchUsage() {
+    std::cerr << "Usage: ac_bench [options]\n"
+              << "\n"
+              << "Options:\n"
+              << "  --size=<n>[K|M|G]         Program size to benchmark, can be repeated\n"
+              << "                            (default: 1K, 64K, 1M, 16M)\n"
+              << "  --seed=<n>                Generator seed (default: 1)\n"
+              << "  --repeat=<n>              Runs per phase; the fastest is reported (default: 3)\n"
+              << "  --codegen-limit=<n>       Only lex and parse programs bigger than this (default: 64M)\n"
+              << "  -O0, -O1, -O2, -O3, -Os   Optimization level for the optimize and emit phases\n"
+              << "  -mcpu=<name>              Target CPU for the emit phase\n"
+              << "  --codegen-threads=<n>     Split the module and emit it on <n> threads\n"
+              << "  --generate=<file>         Only write a program of the first --size to <file>\n"
+              << "  --keep                    Keep the generated inputs (in the temp directory)\n";
+}
+
+bool parseNumber(std::string_view text, uint64_t& value) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+// Parses "123", "64K", "16M", "1G" (powers of 1024).
+bool parseSize(std::string_view text, uint64_t& size) {
+    uint64_t multiplier = 1;
+    if (!text.empty()) {
+        switch (text.back()) {
+            case 'K': case 'k': multiplier = 1024ull; text.remove_suffix(1); break;
+            case 'M': case 'm': multiplier = 1024ull * 1024; text.remove_suffix(1); break;
+            case 'G': case 'g': multiplier = 1024ull * 1024 * 1024; text.remove_suffix(1); break;
+        }
+    }
+    if (!parseNumber(text, size) || size == 0) return false;
+    size *= multiplier;
+    return true;
+}
+
+bool parseBenchCommandLine(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](const char* prefix) { return arg.substr(std::char_traits<char>::length(prefix)); };
+
+        if (arg.rfind("--size=", 0) == 0) {
+            uint64_t size;
+            if (!parseSize(value("--size="), size)) {
+                std::cerr << "Error: Bad size '" << value("--size=") << "'" << std::endl;
+                return false;
+            }
+            options.sizes.push_back(size);
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            if (!parseNumber(value("--seed="), options.seed)) {
+                std::cerr << "Error: Bad seed '" << value("--seed=") << "'" << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--repeat=", 0) == 0) {
+            uint64_t repeat;
+            if (!parseNumber(value("--repeat="), repeat) || repeat == 0) {
+                std::cerr << "Error: Bad repeat count '" << value("--repeat=") << "'" << std::endl;
+                return false;
+            }
+            options.repeat = static_cast<int>(repeat);
+        } else if (arg.rfind("--codegen-limit=", 0) == 0) {
+            if (!parseSize(value("--codegen-limit="), options.codegenLimit)) {
+                std::cerr << "Error: Bad size '" << value("--codegen-limit=") << "'" << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--generate=", 0) == 0) {
+            options.generateOnly = value("--generate=");
+        } else if (arg == "--keep") {
+            options.keepInputs = true;
+        } else if (arg == "-O0") {
+            options.compile.optLevel = OptLevel::O0;
+        } else if (arg == "-O1") {
+            options.compile.optLevel = OptLevel::O1;
+        } else if (arg == "-O2" || arg == "-O") {
+            options.compile.optLevel = OptLevel::O2;
+        } else if (arg == "-O3") {
+            options.compile.optLevel = OptLevel::O3;
+        } else if (arg == "-Os") {
+            options.compile.optLevel = OptLevel::Os;
+        } else if (arg.rfind("--codegen-threads=", 0) == 0) {
+            uint64_t threads;
+            if (!parseNumber(value("--codegen-threads="), threads) || threads == 0 || threads > 1024) {
+                std::cerr << "Error: Bad thread count '" << value("--codegen-threads=") << "'" << std::endl;
+                return false;
+            }
+            options.compile.codegenThreads = static_cast<unsigned>(threads);
+        } else if (arg.rfind("-mcpu=", 0) == 0 || arg.rfind("-march=", 0) == 0) {
+            options.compile.cpu = arg.substr(arg.find('=') + 1);
+        } else {
+            std::cerr << "Error: Unknown option '" << arg << "'" << std::endl;
+            printBenchUsage();
+            return false;
+        }
+    }
+
+    if (options.sizes.empty()) {
+        options.sizes = {1024ull, 64ull * 1024, 1024ull * 1024, 16ull * 1024 * 1024};
+    }
+    return true;
+}
+
+bool writeProgram(const std::string& path, uint64_t size, uint64_t seed) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error: Could not create '" << path << "'" << std::endl;
+        return false;
+    }
+    GeneratorOptions generator;
+    generator.targetBytes = size;
+    generator.seed = seed;
+    GeneratorStats stats = generateProgram(generator, out);
+    out.close();
+    if (!out) {
+        std::cerr << "Error: Could not write '" << path << "'" << std::endl;
+        return false;
+    }
+    std::cerr << "Generated " << path << ": " << stats.bytes << " bytes, " << stats.functions << " functions\n";
+    return true;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// The best time of each phase over all repetitions, and what it produced.
+struct PhaseResults {
+    double lex = 1e300, parse = 1e300, codegen = 1e300, optimize = 1e300, emit = 1e300;
+    uint64_t tokens = 0, astNodes = 0, functions = 0;
+    uint64_t irInstructions = 0, optimizedInstructions = 0, objectBytes = 0;
+    bool codegenRan = false;
+};
+
+// Runs every phase on `source` `options.repeat` times. Returns false if the
+// program doesn't compile, which would mean a bug in the generator.
+bool benchmarkSource(std::string_view source, const BenchOptions& options, PhaseResults& results) {
+    bool runCodegen = source.size() <= options.codegenLimit;
+    std::string objectPath = (std::filesystem::temp_directory_path() / "ac_bench_output.o").string();
+
+    for (int run = 0; run < options.repeat; run++) {
+        // Lexing on its own, interning every identifier from scratch like
+        // every compilation does.
+        {
+            Clock::time_point start = Clock::now();
+            Lexer lexer(source);
+            while (lexer.getNextToken().type != TokenType::END_OF_FILE) {}
+            results.lex = std::min(results.lex, secondsSince(start));
+            results.tokens = lexer.tokenCount();
+        }
+
+        // Lexing and parsing are interleaved, so this phase includes the lexer.
+        Clock::time_point start = Clock::now();
+        Lexer lexer(source);
+        Parser parser(lexer, std::cerr);
+        std::unique_ptr<Ast> ast = parser.parse();
+        results.parse = std::min(results.parse, secondsSince(start));
+        if (!ast) {
+            std::cerr << "Error: The generated program doesn't parse" << std::endl;
+            return false;
+        }
+        results.astNodes = ast->nodeCount();
+
+        if (!runCodegen) continue;
+
+        // Code generation, optimization and emission change the module, so
+        // each repetition starts over from a fresh CodeGen. The simplifier
+        // runs right before code generation and is timed as part of it.
+        start = Clock::now();
+        CodeGen generator(options.compile, std::cout, std::cerr);
+        if (!simplifyAst(*ast, std::cerr) || !generator.generate(*ast)) {
+            std::cerr << "Error: The generated program doesn't compile" << std::endl;
+            return false;
+        }
+        results.codegen = std::min(results.codegen, secondsSince(start));
+        results.functions = generator.functionCount();
+        results.irInstructions = generator.instructionCount();
+        ast.reset();
+
+        start = Clock::now();
+        generator.optimize();
+        results.optimize = std::min(results.optimize, secondsSince(start));
+        results.optimizedInstructions = generator.instructionCount();
+
+        start = Clock::now();
+        if (!generator.emitObjectFile(objectPath)) {
+            return false;
+        }
+        results.emit = std::min(results.emit, secondsSince(start));
+        results.objectBytes = 0;
+        for (const std::string& objectFile : CodeGen::objectFiles(objectPath, options.compile)) {
+            std::error_code ec;
+            results.objectBytes += std::filesystem::file_size(objectFile, ec);
+            std::filesystem::remove(objectFile, ec);
+        }
+        results.codegenRan = true;
+    }
+    return true;
+}
+
+// Touches every page, so that the lexer is measured and not the disk.
+void faultIn(std::string_view text) {
+    volatile char sink = 0;
+    for (size_t i = 0; i < text.size(); i += 4096) sink = sink + text[i];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseBenchCommandLine(argc, argv, options)) {
+        return 1;
+    }
+
+    if (!options.generateOnly.empty()) {
+        return writeProgram(options.generateOnly, options.sizes.front(), options.seed) ? 0 : 1;
+    }
+
+    llvm::json::OStream json(llvm::outs(), 2);
+    json.objectBegin();
+    json.attribute("benchmark", "ac_bench");
+    json.attribute("seed", static_cast<int64_t>(options.seed));
+    json.attribute("repeat", options.repeat);
+    json.attribute("opt_level", optLevelToString(options.compile.optLevel));
+    json.attribute("cpu", options.compile.cpu);
+    json.attribute("codegen_threads", static_cast<int64_t>(options.compile.codegenThreads));
+    json.attributeBegin("results");
+    json.arrayBegin();
+
+    int exitCode = 0;
+    for (uint64_t size : options.sizes) {
+        std::string path = (std::filesystem::temp_directory_path()
+                            / ("ac_bench_" + std::to_string(size) + "_" + std::to_string(options.seed) + ".athx")).string();
+        if (!writeProgram(path, size, options.seed)) {
+            exitCode = 1;
+            break;
+        }
+
+        std::unique_ptr<SourceBuffer> source = SourceBuffer::open(path, std::cerr);
+        if (!source) {
+            exitCode = 1;
+            break;
+        }
+        std::string_view text = source->text();
+        faultIn(text);
+
+        std::cerr << "Benchmarking " << text.size() << " bytes..." << std::endl;
+        PhaseResults results;
+        bool ok = benchmarkSource(text, options, results);
+        source.reset();
+        if (!options.keepInputs) {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+        if (!ok) {
+            exitCode = 1;
+            break;
+        }
+
+        double bytes = static_cast<double>(text.size());
+        json.object([&] {
+            json.attribute("size_bytes", static_cast<int64_t>(size));
+            json.attribute("source_bytes", static_cast<int64_t>(text.size()));
+            json.attributeObject("lex", [&] {
+                json.attribute("seconds", results.lex);
+                json.attribute("tokens", static_cast<int64_t>(results.tokens));
+                json.attribute("tokens_per_second", results.tokens / results.lex);
+                json.attribute("bytes_per_second", bytes / results.lex);
+            });
+            json.attributeObject("parse", [&] {
+                json.attribute("seconds", results.parse);
+                json.attribute("ast_nodes", static_cast<int64_t>(results.astNodes));
+                json.attribute("ast_nodes_per_second", results.astNodes / results.parse);
+                json.attribute("bytes_per_second", bytes / results.parse);
+            });
+            if (!results.codegenRan) {
+                json.attribute("codegen_skipped", true);
+                return;
+            }
+            json.attributeObject("codegen", [&] {
+                json.attribute("seconds", results.codegen);
+                json.attribute("functions", static_cast<int64_t>(results.functions));
+                json.attribute("ir_instructions", static_cast<int64_t>(results.irInstructions));
+                json.attribute("ir_instructions_per_second", results.irInstructions / results.codegen);
+            });
+            json.attributeObject("optimize", [&] {
+                json.attribute("seconds", results.optimize);
+                json.attribute("ir_instructions", static_cast<int64_t>(results.optimizedInstructions));
+            });
+            json.attributeObject("emit", [&] {
+                json.attribute("seconds", results.emit);
+                json.attribute("object_bytes", static_cast<int64_t>(results.objectBytes));
+                json.attribute("ir_instructions_per_second", results.optimizedInstructions / results.emit);
+            });
+        });
+    }
+
+    json.arrayEnd();
+    json.attributeEnd();
+    json.objectEnd();
+    llvm::outs() << "\n";
+    return exitCode;
+}
@@ -0,0 +1,226 @@
+#include "generator.hpp"
+#include <string>
+#include <vector>
+
+namespace {
+
+// SplitMix64. Tiny, fast, and (unlike the <random> distributions) gives the
+// same sequence everywhere.
+class Random {
+public:
+    explicit Random(uint64_t seed) : m_state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // A number in [lo, hi].
+    uint64_t between(uint64_t lo, uint64_t hi) { return lo + next() % (hi - lo + 1); }
+
+    // True with the given probability (in percent).
+    bool chance(unsigned percent) { return next() % 100 < percent; }
+
+private:
+    uint64_t m_state;
+};
+
+// Words for identifiers and string literals. None of them (or their
+// combinations) is a keyword or a built-in name.
+const char* const kWords[] = {
+    "value", "result", "total", "count", "index", "buffer", "offset", "length",
+    "partial", "accumulated", "intermediate", "temporary", "scaled", "weighted",
+    "compute", "update", "transform", "combine", "reduce", "estimate", "measure",
+    "stage", "block", "segment", "matrix", "vector", "factor", "delta", "sample",
+};
+constexpr size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+class ProgramWriter {
+public:
+    ProgramWriter(const GeneratorOptions& options) : m_options(options), m_random(options.seed) {}
+
+    // Appends one function definition to `out`.
+    void writeFunction(std::string& out) {
+        uint64_t index = m_arities.size();
+        unsigned arity = static_cast<unsigned>(m_random.between(0, 4));
+
+        m_variables.clear();
+        // Exported: main calls none of them, so internal ones would all be dropped.
+        out += "export int32_t ";
+        out += functionName(index);
+        out += '(';
+        for (unsigned i = 0; i < arity; i++) {
+            if (i > 0) out += ", ";
+            std::string name = identifier(1, 3) + "_p" + std::to_string(i);
+            out += "int32_t " + name;
+            m_variables.push_back(std::move(name));
+        }
+        out += ") {\n";
+
+        // Strings
+        uint64_t prints = m_random.between(1, 3);
+        for (uint64_t i = 0; i < prints; i++) {
+            out += "    print(\"" + sentence() + "\");\n";
+        }
+
+        // Locals, initialized with expressions of all shapes
+        uint64_t locals = m_random.between(3, 10);
+        for (uint64_t i = 0; i < locals; i++) {
+            std::string name = identifier(1, 4) + "_" + std::to_string(i);
+            out += "    auto " + name + " = ";
+            if (m_random.chance(15)) {
+                writeChain(out);
+            } else {
+                writeExpression(out, m_options.maxExpressionDepth);
+            }
+            out += ";\n";
+            m_variables.push_back(std::move(name));
+
+            if (m_random.chance(10)) {
+                out += "    print(" + pickVariable() + ");\n";
+            }
+        }
+
+        out += "    return ";
+        writeExpression(out, 3);
+        out += ";\n}\n\n";
+
+        m_arities.push_back(static_cast<uint8_t>(arity));
+    }
+
+    // main comes last and doesn't call anything: the call graph of the other
+    // functions would take exponential time to run.
+    void writeMain(std::string& out) {
+        out += "int32_t main() {\n    print(\"" + sentence() + "\");\n    return 0;\n}\n";
+    }
+
+private:
+    std::string functionName(uint64_t index) {
+        // Derived from the index alone, so callers can name any earlier function.
+        std::string name;
+        uint64_t h = index * 0x9E3779B97F4A7C15ull;
+        for (int i = 0; i < 3; i++) {
+            name += kWords[(h >> (i * 8)) % kWordCount];
+            name += '_';
+        }
+        return name + std::to_string(index);
+    }
+
+    std::string identifier(unsigned minWords, unsigned maxWords) {
+        std::string name;
+        uint64_t words = m_random.between(minWords, maxWords);
+        for (uint64_t i = 0; i < words; i++) {
+            if (i > 0) name += '_';
+            name += kWords[m_random.next() % kWordCount];
+        }
+        return name;
+    }
+
+    std::string sentence() {
+        std::string text;
+        uint64_t words = m_random.between(2, 10);
+        for (uint64_t i = 0; i < words; i++) {
+            if (i > 0) text += ' ';
+            text += kWords[m_random.next() % kWordCount];
+        }
+        return text;
+    }
+
+    const std::string& pickVariable() {
+        return m_variables[m_random.next() % m_variables.size()];
+    }
+
+    void writeLeaf(std::string& out) {
+        if (!m_variables.empty() && m_random.chance(60)) {
+            out += pickVariable();
+        } else {
+            out += std::to_string(m_random.between(0, 9999));
+        }
+    }
+
+    void writeCall(std::string& out) {
+        uint64_t callee = m_random.next() % m_arities.size();
+        out += functionName(callee);
+        out += '(';
+        for (unsigned i = 0; i < m_arities[callee]; i++) {
+            if (i > 0) out += ", ";
+            writeExpression(out, 1);
+        }
+        out += ')';
+    }
+
+    void writeExpression(std::string& out, int depth) {
+        if (depth <= 0 || m_random.chance(20)) {
+            // Calls only go to functions defined earlier.
+            if (!m_arities.empty() && m_random.chance(10)) {
+                writeCall(out);
+            } else {
+                writeLeaf(out);
+            }
+            return;
+        }
+
+        static const char kOperators[] = {'+', '-', '*', '/'};
+        char op = kOperators[m_random.next() % 4];
+        bool parenthesize = m_random.chance(40);
+
+        if (parenthesize) out += '(';
+        writeExpression(out, depth - 1);
+        out += ' ';
+        out += op;
+        out += ' ';
+        if (op == '/') {
+            // Never divide by zero: divisors are non-zero literals.
+            out += std::to_string(m_random.between(1, 99));
+        } else {
+            writeExpression(out, depth - 1);
+        }
+        if (parenthesize) out += ')';
+    }
+
+    // A long flat chain like `a + b * c - d ...`, which the parser turns into
+    // a deep left-leaning tree.
+    void writeChain(std::string& out) {
+        static const char kOperators[] = {'+', '-', '*'};
+        uint64_t terms = m_random.between(20, 60);
+        writeLeaf(out);
+        for (uint64_t i = 1; i < terms; i++) {
+            out += ' ';
+            out += kOperators[m_random.next() % 3];
+            out += ' ';
+            writeLeaf(out);
+        }
+    }
+
+    const GeneratorOptions& m_options;
+    Random m_random;
+    std::vector<uint8_t> m_arities;      // Parameter count of every function so far
+    std::vector<std::string> m_variables; // In scope in the current function
+};
+
+} // namespace
+
+GeneratorStats generateProgram(const GeneratorOptions& options, std::ostream& out) {
+    ProgramWriter writer(options);
+    GeneratorStats stats;
+
+    // Functions are generated into a small buffer and written out one at a
+    // time, so even a 1 GB program never has to fit in memory.
+    std::string buffer;
+    while (stats.bytes < options.targetBytes) {
+        buffer.clear();
+        writer.writeFunction(buffer);
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        stats.bytes += buffer.size();
+        stats.functions++;
+    }
+
+    buffer.clear();
+    writer.writeMain(buffer);
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    stats.bytes += buffer.size();
+    stats.functions++;
+    return stats;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+
+// --- Synthetic Program Generator ---
+// Writes a valid Atheria program of (roughly) a given size, for benchmarking
+// the front end and code generator. The output depends only on the options:
+// the same seed and size give the same bytes on every platform and standard
+// library, so numbers from different machines and builds are comparable.
+//
+// The programs are built to exercise the compiler's hot paths:
+//   - many functions, each calling functions defined before it
+//   - deep expression trees, both nested and long flat chains
+//   - long identifiers made of several words
+//   - many string literals, passed to print()
+struct GeneratorOptions {
+    uint64_t targetBytes = 1024 * 1024; // The program stops at the first function past this size
+    uint64_t seed = 1;
+    int maxExpressionDepth = 5;         // Nesting depth of the random expression trees
+};
+
+// Statistics about what was generated.
+struct GeneratorStats {
+    uint64_t bytes = 0;
+    uint64_t functions = 0; // Including main
+};
+
+GeneratorStats generateProgram(const GeneratorOptions& options, std::ostream& out);
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Profile-guided optimization: how much faster does a kernel get when `ac`
+# optimizes it with a profile of its own run?
+#
+#   bench/pgo/run.sh [path/to/ac]
+#
+# Builds kernel.athx three times at -O$LEVEL: without a profile ("base"), with
+# -fprofile-generate (which is then run once to write the raw profile), and
+# with -fprofile-use on the merged profile ("pgo"). Both the base and the pgo
+# program are run RUNS times; the table shows the best wall time of each and
+# the speedup. The two programs must print the same result.
+#
+# Environment: LLVM_PROFDATA (default llvm-profdata), LEVEL (default 2),
+# RUNS (default 5). Linking the instrumented program needs compiler-rt's
+# profile runtime (see $ATHERIA_PROFILE_RUNTIME).
+set -eu
+
+AC=${1:-ac}
+LLVM_PROFDATA=${LLVM_PROFDATA:-llvm-profdata}
+LEVEL=${LEVEL:-2}
+RUNS=${RUNS:-5}
+
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+now_ns() { date +%s%N; }
+
+# Prints the best wall time of RUNS runs of $1, in milliseconds.
+best_ms() {
+    best=
+    i=0
+    while [ "$i" -lt "$RUNS" ]; do
+        start=$(now_ns)
+        "$1" >/dev/null
+        end=$(now_ns)
+        elapsed=$((end - start))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+        i=$((i + 1))
+    done
+    echo "$best" | awk '{ printf "%.1f", $1 / 1000000 }'
+}
+
+# 1. The baseline, and the instrumented build run once for its profile.
+"$AC" "-O$LEVEL" "$here/kernel.athx" -o "$work/base" >/dev/null
+"$AC" "-O$LEVEL" -fprofile-generate="$work/raw" "$here/kernel.athx" -o "$work/instrumented" >/dev/null
+LLVM_PROFILE_FILE="$work/raw/kernel.profraw" "$work/instrumented" >/dev/null
+
+# 2. The optimized build, from the merged profile.
+"$LLVM_PROFDATA" merge -o "$work/kernel.profdata" "$work/raw/kernel.profraw"
+"$AC" "-O$LEVEL" -fprofile-use="$work/kernel.profdata" "$here/kernel.athx" -o "$work/pgo" >/dev/null
+
+expected=$("$work/base")
+actual=$("$work/pgo")
+if [ "$expected" != "$actual" ]; then
+    echo "error: the pgo build printed '$actual', the base build '$expected'" >&2
+    exit 1
+fi
+
+base=$(best_ms "$work/base")
+pgo=$(best_ms "$work/pgo")
+printf "%-6s %10s %10s %9s\n" "level" "base ms" "pgo ms" "speedup"
+printf "%-6s %10s %10s %9s\n" "-O$LEVEL" "$base" "$pgo" "$(echo "$base $pgo" | awk '{ printf "%.2fx", $1 / $2 }')"
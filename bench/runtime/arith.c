@@ -0,0 +1,26 @@
+// C reference for arith.athx: 16 rounds of a multiply/divide mixing function.
+// Compiled with -fwrapv, so overflow wraps around like the code `ac` emits.
+#include <stdint.h>
+
+static int32_t mix(int32_t a, int32_t b) {
+    int32_t t = a * 31 + b;
+    int32_t u = t / 7 - a * 3;
+    int32_t v = u * 17 + t / 3;
+    return v - b * 5;
+}
+
+static int32_t round4(int32_t x, int32_t k) {
+    int32_t a = mix(x, k);
+    int32_t b = mix(a, x + 1);
+    int32_t c = mix(b, a - k);
+    int32_t d = mix(c, b * 2);
+    return d;
+}
+
+int32_t bench_kernel(int32_t seed) {
+    int32_t r1 = round4(seed, 101);
+    int32_t r2 = round4(r1, 202);
+    int32_t r3 = round4(r2, 303);
+    int32_t r4 = round4(r3, 404);
+    return r4;
+}
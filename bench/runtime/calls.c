@@ -0,0 +1,40 @@
+// C reference for calls.athx. The language has no branches, so recursion
+// can't terminate; instead a fixed-depth call tree makes 256 calls to leaf()
+// (and 254 to the levels in between) per kernel invocation.
+#include <stdint.h>
+
+static int32_t leaf(int32_t x) {
+    return x * x / 7 + x;
+}
+
+static int32_t level7(int32_t x) {
+    return leaf(x) + leaf(x + 1);
+}
+
+static int32_t level6(int32_t x) {
+    return level7(x) + level7(x + 2);
+}
+
+static int32_t level5(int32_t x) {
+    return level6(x) + level6(x + 3);
+}
+
+static int32_t level4(int32_t x) {
+    return level5(x) + level5(x + 4);
+}
+
+static int32_t level3(int32_t x) {
+    return level4(x) + level4(x + 5);
+}
+
+static int32_t level2(int32_t x) {
+    return level3(x) + level3(x + 6);
+}
+
+static int32_t level1(int32_t x) {
+    return level2(x) + level2(x + 7);
+}
+
+int32_t bench_kernel(int32_t seed) {
+    return level1(seed) - level1(seed + 9);
+}
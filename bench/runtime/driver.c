@@ -0,0 +1,34 @@
+// Shared driver for the runtime benchmarks. The kernels can't loop (the
+// language has no loops or branches yet), so the loop lives here: it calls
+// the kernel's bench_kernel() once per iteration and reports on stderr
+//
+//   <seconds> <checksum>
+//
+// The checksum folds in every result, so run.sh can check that the code from
+// `ac` and from the C compiler computed the same thing. The driver is always
+// built the same way and linked against either object, so only the kernel differs.
+// Kernels export bench_kernel() and nothing else: their helpers are internal
+// in the .athx versions and `static` in the C ones.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+int32_t bench_kernel(int32_t seed);
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 1000000;
+
+    struct timespec start, end;
+    uint32_t checksum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < iterations; i++) {
+        checksum = checksum * 31 + (uint32_t)bench_kernel((int32_t)i);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    fflush(stdout);
+    fprintf(stderr, "%.9f %u\n", seconds, checksum);
+    return 0;
+}
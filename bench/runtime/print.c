@@ -0,0 +1,12 @@
+// C reference for print.athx: `ac` lowers print() to printf with a "%s\n" or
+// "%d\n" format, so this does exactly the same calls.
+#include <stdint.h>
+#include <stdio.h>
+
+int32_t bench_kernel(int32_t seed) {
+    printf("%s\n", "tick");
+    printf("%d\n", seed);
+    printf("%s\n", "a somewhat longer line of benchmark output text");
+    printf("%d\n", seed * 7 + 3);
+    return seed;
+}
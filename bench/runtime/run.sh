@@ -0,0 +1,98 @@
+#!/bin/sh
+# Runtime benchmarks: how fast is the code `ac` generates, compared with the
+# same kernels written in C?
+#
+#   bench/runtime/run.sh [--json] [path/to/ac]
+#
+# For every kernel (*.athx with a matching *.c) and optimization level, both
+# versions are compiled at that level, linked against driver.c, run, and
+# checked to produce the same checksum. The table shows nanoseconds per kernel
+# call and the slowdown of `ac` relative to C (ratio > 1 means ac is slower).
+# With --json the same results are printed as a JSON array instead.
+#
+# Environment: CC (default cc), LEVELS (default "0 1 2 3"),
+# SCALE (multiplies every kernel's iteration count, default 1).
+set -eu
+
+json=0
+if [ "${1:-}" = "--json" ]; then
+    json=1
+    shift
+fi
+
+AC=${1:-ac}
+CC=${CC:-cc}
+LEVELS=${LEVELS:-"0 1 2 3"}
+SCALE=${SCALE:-1}
+
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Sized for roughly a second per run at -O0 on a typical machine.
+iterations_for() {
+    case "$1" in
+        arith) echo $((2000000 * SCALE)) ;;
+        calls) echo $((200000 * SCALE)) ;;
+        print) echo $((500000 * SCALE)) ;;
+        *) echo $((1000000 * SCALE)) ;;
+    esac
+}
+
+# Prints "<seconds> <checksum>" for one run of a benchmark executable.
+# The kernels' own output (print-heavy ones produce a lot) is discarded.
+measure() {
+    "$1" "$2" 2>&1 >/dev/null
+}
+
+"$CC" -O2 -c "$here/driver.c" -o "$work/driver.o"
+
+if [ "$json" = 1 ]; then
+    echo "["
+else
+    printf "%-8s %-5s %14s %14s %9s\n" "kernel" "level" "ac ns/call" "C ns/call" "ratio"
+fi
+
+first=1
+status=0
+for source in "$here"/*.athx; do
+    kernel=$(basename "$source" .athx)
+    [ -f "$here/$kernel.c" ] || continue
+    iterations=$(iterations_for "$kernel")
+
+    for level in $LEVELS; do
+        "$AC" "-O$level" "$source" -o "$work/$kernel.ac.o" >/dev/null
+        "$CC" "-O$level" -fwrapv -c "$here/$kernel.c" -o "$work/$kernel.c.o"
+        "$CC" "$work/driver.o" "$work/$kernel.ac.o" -o "$work/$kernel.ac"
+        "$CC" "$work/driver.o" "$work/$kernel.c.o" -o "$work/$kernel.c"
+
+        set -- $(measure "$work/$kernel.ac" "$iterations")
+        ac_seconds=$1 ac_checksum=$2
+        set -- $(measure "$work/$kernel.c" "$iterations")
+        c_seconds=$1 c_checksum=$2
+
+        if [ "$ac_checksum" != "$c_checksum" ]; then
+            echo "error: $kernel -O$level: ac computed checksum $ac_checksum, C computed $c_checksum" >&2
+            status=1
+        fi
+
+        if [ "$json" = 1 ]; then
+            [ "$first" = 1 ] || echo ","
+            awk -v k="$kernel" -v l="$level" -v n="$iterations" -v a="$ac_seconds" -v c="$c_seconds" 'BEGIN {
+                printf "  {\"kernel\": \"%s\", \"opt_level\": %d, \"iterations\": %d, \"ac_seconds\": %.9f, \"c_seconds\": %.9f, \"ratio\": %.4f}",
+                       k, l, n, a, c, (c > 0 ? a / c : 0)
+            }'
+        else
+            awk -v k="$kernel" -v l="-O$level" -v n="$iterations" -v a="$ac_seconds" -v c="$c_seconds" 'BEGIN {
+                printf "%-8s %-5s %14.2f %14.2f %8.2fx\n", k, l, a * 1e9 / n, c * 1e9 / n, (c > 0 ? a / c : 0)
+            }'
+        fi
+        first=0
+    done
+done
+
+if [ "$json" = 1 ]; then
+    echo
+    echo "]"
+fi
+exit $status
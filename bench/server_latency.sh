@@ -0,0 +1,74 @@
+#!/bin/sh
+# Compile latency with and without the compile server (ac --server): how much
+# of a small compile is process startup and target setup?
+#
+#   bench/server_latency.sh [path/to/ac]
+#
+# Compiles the runtime benchmark kernels (small, realistic files) COUNT times
+# each: with a fresh `ac` process per file ("cold"), then through a server
+# started for the occasion, once with `ac --connect` as the client ("ac") and
+# once with the LLVM-free `ac_client` next to ac ("ac_client"). Each row shows
+# the mean wall time per compile, including the client process.
+#
+# Environment: CLIENT (default: ac_client next to ac), COUNT (compiles per kernel and level, default 20),
+# LEVELS (default "0 2").
+set -eu
+
+AC=${1:-ac}
+CLIENT=${CLIENT:-$(dirname "$AC")/ac_client}
+COUNT=${COUNT:-20}
+LEVELS=${LEVELS:-"0 2"}
+
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+socket="$work/ac.sock"
+server_pid=
+cleanup() {
+    [ -n "$server_pid" ] && kill "$server_pid" 2>/dev/null
+    rm -rf "$work"
+}
+trap cleanup EXIT
+
+now_ns() { date +%s%N; }
+
+# Prints the mean milliseconds per compile of every kernel, COUNT times, with
+# the compiler $1 at -O$2. Any further arguments go to the compiler.
+mean_ms() {
+    compiler=$1
+    level=$2
+    shift 2
+    n=0
+    start=$(now_ns)
+    i=0
+    while [ "$i" -lt "$COUNT" ]; do
+        for source in "$here"/runtime/*.athx; do
+            "$compiler" "$@" "-O$level" "$source" -o "$work/out.o" >/dev/null
+            n=$((n + 1))
+        done
+        i=$((i + 1))
+    done
+    end=$(now_ns)
+    echo "$(( (end - start) / n / 1000 ))" | awk '{ printf "%.2f", $1 / 1000 }'
+}
+
+"$AC" --server="$socket" >/dev/null &
+server_pid=$!
+tries=0
+while [ ! -S "$socket" ]; do
+    tries=$((tries + 1))
+    if [ "$tries" -gt 100 ]; then
+        echo "error: the compile server did not start" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+printf "%-6s %10s %10s %9s %14s %9s\n" "level" "cold ms" "ac ms" "speedup" "ac_client ms" "speedup"
+for level in $LEVELS; do
+    cold=$(mean_ms "$AC" "$level")
+    connected=$(mean_ms "$AC" "$level" --connect="$socket")
+    thin=$(mean_ms "$CLIENT" "$level" --connect="$socket")
+    printf "%-6s %10s %10s %9s %14s %9s\n" "-O$level" "$cold" \
+        "$connected" "$(echo "$cold $connected" | awk '{ printf "%.2fx", $1 / $2 }')" \
+        "$thin" "$(echo "$cold $thin" | awk '{ printf "%.2fx", $1 / $2 }')"
+done
@@ -0,0 +1,101 @@
+#!/bin/sh
+# Regression checks for bugs that only show up across several compiles or in
+# the way a compile fails, which a single example program can't catch.
+#
+#   checks/run.sh [path/to/ac]
+#
+# Prints one line per check and exits with 1 if any of them failed.
+#
+# Environment: CC (C compiler used to link, default cc).
+set -u
+
+AC=${1:-ac}
+CC=${CC:-cc}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+pass() { echo "ok    $1"; }
+fail() {
+    echo "FAIL  $1: $2"
+    failures=$((failures + 1))
+}
+
+# --- Incremental compiles ---
+
+# Turning `static` into `export` (and back) must recompile the function
+# itself, not only the function written before it: the qualifier comes
+# before the return type, outside the text of its own function.
+check_incremental_linkage() {
+    name="incremental: static <-> export"
+    dir="$work/linkage"
+    mkdir -p "$dir"
+    cat > "$dir/driver.c" <<'EOF'
+int f(int);
+int main(void) { return f(2) == 3 ? 0 : 1; }
+EOF
+    for qualifier in static export static; do
+        cat > "$dir/a.athx" <<EOF
+int32_t g(int32_t x) {
+    return x + 1;
+}
+
+$qualifier int32_t f(int32_t x) {
+    return g(x);
+}
+
+export int32_t keep(int32_t x) {
+    return f(x);
+}
+EOF
+        if ! "$AC" --incremental="$dir/cache" --incremental-chunks=3 -c "$dir/a.athx" -o "$dir/a.o" > "$dir/log" 2>&1; then
+            fail "$name" "compiling with '$qualifier f' failed: $(cat "$dir/log")"
+            return
+        fi
+        [ "$qualifier" = export ] || continue
+        if ! "$CC" -o "$dir/a.out" "$dir/driver.c" "$dir/a.o" "$dir/a.1.o" "$dir/a.2.o" > "$dir/log" 2>&1; then
+            fail "$name" "linking after the flip failed: $(cat "$dir/log")"
+            return
+        fi
+        if ! "$dir/a.out"; then
+            fail "$name" "f(2) isn't 3"
+            return
+        fi
+    done
+    pass "$name"
+}
+
+# --- Compile-time evaluation ---
+
+# A constexpr function that calls itself must stop at -fconstexpr-depth with
+# an error, however deep that is; the thread compiling it mustn't run out of
+# stack first.
+check_constexpr_depth() {
+    name="constexpr: deep calls are an error, not a crash"
+    dir="$work/depth"
+    mkdir -p "$dir"
+    cat > "$dir/down.athx" <<'EOF'
+constexpr int32_t down(int32_t n) {
+    return down(n - 1);
+}
+
+int32_t main() {
+    return down(5);
+}
+EOF
+    "$AC" -fconstexpr-depth=1M -fconstexpr-steps=16M -c "$dir/down.athx" -o "$dir/down.o" > "$dir/log" 2>&1
+    status=$?
+    if [ "$status" -eq 0 ] || [ "$status" -gt 128 ]; then
+        fail "$name" "ac exited with $status"
+    elif ! grep -q "nests calls more than 1048576 deep" "$dir/log"; then
+        fail "$name" "no depth error: $(cat "$dir/log")"
+    else
+        pass "$name"
+    fi
+}
+
+check_incremental_linkage
+check_constexpr_depth
+
+[ "$failures" -eq 0 ] || exit 1
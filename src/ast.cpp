@@ -0,0 +1,85 @@
+#include "ast.hpp"
+
+Ast::Ast(std::string_view source) : m_source(source) {
+    // Slot 0 is the "no node" / "no token" sentinel.
+    m_nodes.push_back(AstNode{});
+    m_tokens.push_back(Token{});
+}
+
+void Ast::reserve(size_t tokenCount) {
+    // Typical programs produce a bit under one node and one stored token per
+    // token, and far fewer list entries. Pages that end up unused are never touched.
+    m_nodes.reserve(tokenCount);
+    m_tokens.reserve(tokenCount);
+    m_extra.reserve(tokenCount / 4);
+}
+
+TokenIndex Ast::addToken(const Token& token) {
+    m_tokens.push_back(token);
+    return static_cast<TokenIndex>(m_tokens.size() - 1);
+}
+
+NodeIndex Ast::addNode(NodeKind kind, TokenIndex token, uint32_t lhs, uint32_t rhs) {
+    m_nodes.push_back(AstNode{kind, token, lhs, rhs});
+    return static_cast<NodeIndex>(m_nodes.size() - 1);
+}
+
+uint32_t Ast::addList(const std::vector<NodeIndex>& items) {
+    uint32_t start = static_cast<uint32_t>(m_extra.size());
+    m_extra.insert(m_extra.end(), items.begin(), items.end());
+    return start;
+}
+
+NodeIndex Ast::addCall(NodeKind kind, TokenIndex callee, const std::vector<NodeIndex>& arguments) {
+    uint32_t start = addList(arguments);
+    return addNode(kind, callee, start, static_cast<uint32_t>(arguments.size()));
+}
+
+// A function needs more than fits in a node, so the node points at a header in
+// the extra array: [returnType, paramCount, bodyCount, params..., body...]
+NodeIndex Ast::addFunction(uint32_t qualifiers, TokenIndex returnType, TokenIndex name,
+                           const std::vector<NodeIndex>& parameters, const std::vector<NodeIndex>& body) {
+    uint32_t header = static_cast<uint32_t>(m_extra.size());
+    m_extra.push_back(returnType);
+    m_extra.push_back(static_cast<uint32_t>(parameters.size()));
+    m_extra.push_back(static_cast<uint32_t>(body.size()));
+    addList(parameters);
+    addList(body);
+    return addNode(NodeKind::FunctionDefinition, name, header, qualifiers);
+}
+
+NodeIndex Ast::addProgram(const std::vector<NodeIndex>& functions) {
+    uint32_t start = addList(functions);
+    m_root = addNode(NodeKind::Program, 0, start, static_cast<uint32_t>(functions.size()));
+    return m_root;
+}
+
+ProgramNode Ast::program(NodeIndex index) const {
+    const AstNode& n = m_nodes[index];
+    return ProgramNode{list(n.lhs, n.rhs)};
+}
+
+FunctionDefinitionNode Ast::function(NodeIndex index) const {
+    const AstNode& n = m_nodes[index];
+    uint32_t header = n.lhs;
+    uint32_t paramCount = m_extra[header + 1];
+    uint32_t bodyCount = m_extra[header + 2];
+    return FunctionDefinitionNode{
+        m_tokens[m_extra[header]],
+        m_tokens[n.token],
+        list(header + 3, paramCount),
+        list(header + 3 + paramCount, bodyCount),
+        n.rhs,
+    };
+}
+
+ParameterNode Ast::parameter(NodeIndex index) const {
+    const AstNode& n = m_nodes[index];
+    return ParameterNode{m_tokens[n.lhs], m_tokens[n.token]};
+}
+
+size_t Ast::memoryUsage() const {
+    return m_nodes.capacity() * sizeof(AstNode)
+         + m_extra.capacity() * sizeof(uint32_t)
+         + m_tokens.capacity() * sizeof(Token);
+}
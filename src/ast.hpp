@@ -1,129 +1,227 @@
 #pragma once
+#include <cstdint>
 #include <string>
-#include <vector>
-#include <memory>
-#include <map>
+#include <string_view>
 #include <vector>
 #include "token.hpp" // We need the Token struct
 
-
-struct ProgramNode;
-struct FunctionDefinitionNode;
-struct StatementNode;
-struct ExpressionNode;
-struct FunctionCallStatementNode;
-struct StringLiteralNode;
-struct NumberLiteralNode;
-struct BinaryOpNode;
-struct VariableNode;
-struct ParameterNode;
-struct ReturnStatementNode;
-struct AutoStatementNode;
-struct FunctionCallExpressionNode;
-// --- Visitor Pattern ---
-// This is a clean way to process AST nodes without cluttering the node classes themselves.
-// We'll use it for our AstPrinter, and later for the Code Generator.
-struct AstVisitor {
-    virtual void visit(ProgramNode* node) = 0;
-    virtual void visit(FunctionDefinitionNode* node) = 0;
-    virtual void visit(FunctionCallStatementNode* node) = 0;
-    virtual void visit(StringLiteralNode* node) = 0;
-    virtual void visit(NumberLiteralNode* node) = 0;
-    virtual void visit(BinaryOpNode* node) = 0;
-    virtual void visit(VariableNode* node) = 0;
-    virtual void visit(ReturnStatementNode* node) = 0;
-    virtual void visit(AutoStatementNode* node) = 0;
-    virtual void visit(FunctionCallExpressionNode* node) = 0;
+// --- Node Storage ---
+// The whole tree lives in a few flat arrays owned by a single Ast object.
+// Nodes point at each other with 32-bit indices instead of pointers, so
+// building the tree is a handful of vector appends instead of one malloc per
+// node, walking it stays inside a few contiguous blocks of memory, and the
+// whole thing is released in one go when the Ast is destroyed.
+using NodeIndex = uint32_t;
+using TokenIndex = uint32_t;
+
+// Index 0 is never a real node, so it can mean "no node" the way nullptr used to.
+constexpr NodeIndex kNoNode = 0;
+
+// The type tag stored in every node.
+enum class NodeKind : uint8_t {
+    Invalid,
+    Program,
+    FunctionDefinition,
+    Parameter,
+    FunctionCallStatement,
+    ReturnStatement,
+    AutoStatement,
+    AssignmentStatement,
+    StringLiteral,
+    NumberLiteral,
+    Variable,
+    BinaryOp,
+    FunctionCallExpression,
+    // Only made by the simplifier (see simplify.hpp), never by the parser
+    Constant,
+    ShiftLeft,
+    DivideByPowerOfTwo,
 };
 
-
-// --- Base Node Types ---
-// All nodes in our AST will inherit from AstNode.
+// Every node is 16 bytes. What `token`, `lhs` and `rhs` hold depends on the kind:
+//
+//   Program                  lhs = first function in the extra array, rhs = function count
+//   FunctionDefinition       token = name, lhs = header in the extra array (see Ast::addFunction), rhs = qualifier bits
+//   Parameter                token = name, lhs = type token
+//   FunctionCallStatement    token = callee, lhs = first argument in the extra array, rhs = count
+//   FunctionCallExpression   (same layout as FunctionCallStatement)
+//   ReturnStatement          token = the 'return' keyword, lhs = returned expression
+//   AutoStatement            token = variable name, lhs = initializer expression
+//   AssignmentStatement      token = variable name, lhs = assigned expression
+//   StringLiteral            token = the literal
+//   NumberLiteral            token = the literal
+//   Variable                 token = the name
+//   BinaryOp                 token = operator, lhs = left operand, rhs = right operand
+//   Constant                 token = what it was computed from (for diagnostics), lhs = the int32_t's bits
+//   ShiftLeft                token = the '*' it replaces, lhs = operand, rhs = shift amount
+//   DivideByPowerOfTwo       token = the '/' it replaces, lhs = operand (signed), rhs = log2 of the divisor
 struct AstNode {
-    virtual ~AstNode() = default;
-    virtual void accept(AstVisitor& visitor) = 0;
+    NodeKind kind = NodeKind::Invalid;
+    TokenIndex token = 0;
+    uint32_t lhs = 0;
+    uint32_t rhs = 0;
 };
 
-// Base class for all "statement" nodes (actions that don't produce a value)
-struct StatementNode : public AstNode {};
-
-// Base class for all "expression" nodes (things that produce a value)
-struct ExpressionNode : public AstNode {};
+// The qualifiers written before a function's return type, as bits.
+namespace qualifier {
+enum : uint32_t {
+    Constexpr = 1 << 0, // May be evaluated at compile time (see consteval.hpp)
+    Export = 1 << 1,    // Visible outside its object file (see CodeGen::lowerFunction)
+    Static = 1 << 2,    // Spells out the default: not exported
+};
+}
+
+// A run of child indices stored in the Ast's extra array (function bodies,
+// argument lists, ...). Only valid until more nodes are added to the Ast.
+class NodeList {
+public:
+    NodeList(const NodeIndex* first, uint32_t count) : m_first(first), m_count(count) {}
+
+    const NodeIndex* begin() const { return m_first; }
+    const NodeIndex* end() const { return m_first + m_count; }
+    uint32_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    NodeIndex operator[](uint32_t i) const { return m_first[i]; }
+
+private:
+    const NodeIndex* m_first;
+    uint32_t m_count;
+};
 
+// --- Node Views ---
+// Typed, read-only views of a node, built on the fly by the Ast's accessors
+// below, so code that walks the tree never has to decode AstNode. Walkers
+// switch on Ast::kind() and ask for the view that goes with the kind.
+struct ProgramNode {
+    NodeList functions;
+};
 
-// --- Concrete Node Types ---
+struct FunctionDefinitionNode {
+    const Token& returnType;
+    const Token& functionName;
+    NodeList parameters;
+    NodeList body;
+    uint32_t qualifiers; // qualifier:: bits
+    bool isConstexpr() const { return (qualifiers & qualifier::Constexpr) != 0; }
+    bool isExported() const { return (qualifiers & qualifier::Export) != 0; }
+};
 
-struct StringLiteralNode : public ExpressionNode {
-    Token value; // The STRING_LITERAL token
+struct ParameterNode {
+    const Token& type;
+    const Token& name;
+};
 
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
+// Both FunctionCallStatement and FunctionCallExpression.
+struct FunctionCallNode {
+    const Token& functionName;
+    NodeList arguments;
 };
 
-struct FunctionCallStatementNode : public StatementNode {
-    Token functionName;
-    std::vector<std::unique_ptr<ExpressionNode>> arguments;
+struct ReturnStatementNode {
+    const Token& keyword;
+    NodeIndex returnValue;
+};
 
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
+struct AutoStatementNode {
+    const Token& name;
+    NodeIndex initializer;
 };
 
-struct FunctionDefinitionNode : public AstNode {
-    Token returnType;
-    Token functionName;
-    std::vector<std::unique_ptr<StatementNode>> body;
-    std::vector<std::unique_ptr<ParameterNode>> parameters;
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
+struct AssignmentStatementNode {
+    const Token& name;
+    NodeIndex value;
 };
 
-struct ParameterNode : public AstNode {
-    Token type;
-    Token name;
-    // This is no longer an override, but it's cleaner to remove it.
-    // void accept(AstVisitor& visitor) override { visitor.visit(this); } // <-- DELETE THIS LINE
-    // Let's make it an error to call accept on it.
-    void accept(AstVisitor& visitor) override {
-        // This should never be called. Parameters are handled directly by FunctionDefinitionNode's visitor.
-        (void)visitor; // a way to tell the compiler we are intentionally not using a parameter
-    }
+struct BinaryOpNode {
+    NodeIndex left;
+    const Token& op; // The operator token (+, -, *, /)
+    NodeIndex right;
 };
-// The root of our entire tree
-struct ProgramNode : public AstNode {
-    std::vector<std::unique_ptr<FunctionDefinitionNode>> functions;
 
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
+// Both ShiftLeft and DivideByPowerOfTwo.
+struct ShiftNode {
+    NodeIndex operand;
+    uint32_t amount;
 };
 
+// --- The Tree ---
+// Owns every node, list and token of one compilation unit.
+class Ast {
+public:
+    // `source` is the buffer the tokens point into; it must outlive the Ast.
+    Ast(std::string_view source);
+
+    // --- Building (used by the Parser) ---
+    // Sizes the arrays for a token stream of (roughly) the given length up
+    // front, so they don't have to be copied over and over while the tree grows.
+    void reserve(size_t tokenCount);
+
+    // Tokens are copied into the Ast so it doesn't depend on the token stream.
+    // They are small records that point into the source, so this is cheap.
+    TokenIndex addToken(const Token& token);
+    NodeIndex addNode(NodeKind kind, TokenIndex token = 0, uint32_t lhs = 0, uint32_t rhs = 0);
+    NodeIndex addCall(NodeKind kind, TokenIndex callee, const std::vector<NodeIndex>& arguments);
+    NodeIndex addFunction(uint32_t qualifiers, TokenIndex returnType, TokenIndex name,
+                          const std::vector<NodeIndex>& parameters, const std::vector<NodeIndex>& body);
+    NodeIndex addProgram(const std::vector<NodeIndex>& functions);
+
+    // Overwrites a node, for passes that rewrite the tree in place: whatever
+    // pointed at `index` now points at the new node.
+    void replaceNode(NodeIndex index, const AstNode& node) { m_nodes[index] = node; }
+
+    // --- Reading ---
+    NodeIndex root() const { return m_root; }
+    const AstNode& node(NodeIndex index) const { return m_nodes[index]; }
+    NodeKind kind(NodeIndex index) const { return m_nodes[index].kind; }
+    const Token& token(TokenIndex index) const { return m_tokens[index]; }
+
+    // The source text the tokens point into.
+    std::string_view source() const { return m_source; }
+
+    // The text of a token (e.g. a name or the contents of a string literal).
+    std::string_view text(const Token& token) const { return token.text(m_source); }
+
+    // The node views (see above); `index` must be a node of the matching kind. The small ones are defined
+    // here so that walking an expression compiles down to a few loads.
+    ProgramNode program(NodeIndex index) const;
+    FunctionDefinitionNode function(NodeIndex index) const;
+    ParameterNode parameter(NodeIndex index) const;
+    FunctionCallNode call(NodeIndex index) const {
+        const AstNode& n = m_nodes[index];
+        return FunctionCallNode{m_tokens[n.token], list(n.lhs, n.rhs)};
+    }
+    ReturnStatementNode returnStatement(NodeIndex index) const {
+        return ReturnStatementNode{m_tokens[m_nodes[index].token], m_nodes[index].lhs};
+    }
+    AutoStatementNode autoStatement(NodeIndex index) const {
+        return AutoStatementNode{m_tokens[m_nodes[index].token], m_nodes[index].lhs};
+    }
+    AssignmentStatementNode assignment(NodeIndex index) const {
+        return AssignmentStatementNode{m_tokens[m_nodes[index].token], m_nodes[index].lhs};
+    }
+    BinaryOpNode binaryOp(NodeIndex index) const {
+        const AstNode& n = m_nodes[index];
+        return BinaryOpNode{n.lhs, m_tokens[n.token], n.rhs};
+    }
 
-struct NumberLiteralNode : public ExpressionNode {
-    Token value; // The NUMBER_LITERAL token
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
-};
+    ShiftNode shift(NodeIndex index) const { return ShiftNode{m_nodes[index].lhs, m_nodes[index].rhs}; }
+    int32_t constant(NodeIndex index) const { return static_cast<int32_t>(m_nodes[index].lhs); }
 
-struct VariableNode : public ExpressionNode {
-    Token name; // The IDENTIFIER token
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
-};
+    // The token of a StringLiteral, NumberLiteral, Variable or Constant: all there is to them.
+    const Token& leafToken(NodeIndex index) const { return m_tokens[m_nodes[index].token]; }
 
-struct BinaryOpNode : public ExpressionNode {
-    std::unique_ptr<ExpressionNode> left;
-    Token op; // The operator token (+, -, *, /)
-    std::unique_ptr<ExpressionNode> right;
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
-};
+    // --- Statistics ---
+    size_t nodeCount() const { return m_nodes.size() - 1; }
+    size_t memoryUsage() const; // Bytes held by the node, list and token arrays
 
-struct ReturnStatementNode : public StatementNode {
-    std::unique_ptr<ExpressionNode> expression;
-    std::unique_ptr<ExpressionNode> returnValue;
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
-};
+private:
+    // Appends the indices to the extra array and returns where they start.
+    uint32_t addList(const std::vector<NodeIndex>& items);
+    NodeList list(uint32_t start, uint32_t count) const { return NodeList(m_extra.data() + start, count); }
 
-struct AutoStatementNode : public StatementNode{
-    Token name;
-    std::unique_ptr<ExpressionNode> initializer;
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
+    std::vector<AstNode> m_nodes;
+    std::vector<uint32_t> m_extra; // Child lists and other variable-length node data
+    std::vector<Token> m_tokens;
+    NodeIndex m_root = kNoNode;
+    std::string_view m_source;
 };
-
-struct FunctionCallExpressionNode : public ExpressionNode{
-    Token functionName;
-    std::vector<std::unique_ptr<ExpressionNode>> arguments;
-    void accept(AstVisitor& visitor) override { visitor.visit(this); }
-};
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "cache.hpp"
+#include "codegen.hpp"
+#include <chrono>
+#include <iomanip>
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Host.h"
+
+#ifndef ATHERIA_VERSION
+#define ATHERIA_VERSION "unknown"
+#endif
+
+// Bump when the layout of the cache or the key changes.
+static constexpr const char* kCacheFormat = "atheria-object-cache-3";
+
+static constexpr const char* kHitsFile = "stats-hits";
+static constexpr const char* kMissesFile = "stats-misses";
+
+ObjectCache::ObjectCache(std::string directory, uint64_t maxBytes)
+    : m_directory(std::move(directory)), m_max_bytes(maxBytes) {}
+
+std::string ObjectCache::key(std::string_view source, const CompileOptions& options) const {
+    // "native" has to be resolved first: the same flag means different code on different hosts.
+    std::string cpu, features;
+    resolveTargetCpu(options, cpu, features);
+
+    llvm::SHA256 hasher;
+    auto add = [&](llvm::StringRef field) {
+        // Every field is followed by a NUL, so no two lists of fields hash the same text.
+        hasher.update(field);
+        hasher.update(llvm::StringRef("\0", 1));
+    };
+    add(kCacheFormat);
+    add(ATHERIA_VERSION);
+    add(LLVM_VERSION_STRING);
+    add(llvm::sys::getDefaultTargetTriple());
+    add(cpu);
+    add(features);
+    add(optLevelToString(options.optLevel));
+    add(std::to_string(options.codegenThreads));
+    add(outputExtension(options) + std::string(options.thinLto ? " thinlto" : ""));
+    add(options.writesIr() ? options.inputs[0] : ""); // LLVM IR names its source file
+    add(options.profileGenerate ? "profile-generate " + options.profileRawFile : "");
+    if (!options.profileUse.empty()) {
+        // The profile decides the code as much as the source does. If it
+        // can't be read, the compile fails anyway.
+        auto profile = llvm::MemoryBuffer::getFile(options.profileUse);
+        add(profile ? (*profile)->getBuffer() : llvm::StringRef("<unreadable profile>"));
+    }
+    add("constexpr " + std::to_string(options.constexprSteps) + " " + std::to_string(options.constexprDepth));
+    add(options.incrementalDir.empty() ? "" : "incremental " + std::to_string(options.incrementalChunks));
+    hasher.update(llvm::StringRef(source.data(), source.size()));
+    return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::string ObjectCache::entryPath(const std::string& key, size_t partition) const {
+    llvm::SmallString<256> path(m_directory);
+    std::string name = "llvmcache-" + key;
+    if (partition > 0) {
+        name += "." + std::to_string(partition);
+    }
+    llvm::sys::path::append(path, name);
+    return std::string(path);
+}
+
+void ObjectCache::count(const char* counterFile) {
+    llvm::SmallString<256> path(m_directory);
+    llvm::sys::path::append(path, counterFile);
+
+    // A single one-byte O_APPEND write is atomic, so counters from concurrent
+    // processes never overwrite each other. The count is the file's size.
+    std::error_code ec;
+    llvm::raw_fd_ostream stream(path, ec, llvm::sys::fs::OF_Append);
+    if (!ec) {
+        stream << '.';
+    }
+}
+
+bool ObjectCache::fetch(const std::string& key, const std::vector<std::string>& outputs, std::ostream& diagnostics) {
+    // Made here already so the first miss is counted; store() reports failures.
+    llvm::sys::fs::create_directories(m_directory);
+
+    // 1. All partitions must be there: eviction may have taken some of them.
+    for (size_t i = 0; i < outputs.size(); i++) {
+        if (!llvm::sys::fs::exists(entryPath(key, i))) {
+            m_misses++;
+            count(kMissesFile);
+            return false;
+        }
+    }
+
+    // 2. Copy, rather than hard-link: a later compile writing to the output
+    //    in place would otherwise corrupt the cache entry.
+    for (size_t i = 0; i < outputs.size(); i++) {
+        std::string entry = entryPath(key, i);
+        if (std::error_code ec = llvm::sys::fs::copy_file(entry, outputs[i])) {
+            // Most likely evicted by another process in the meantime; just compile.
+            diagnostics << "Warning: Could not copy '" << entry << "' from the cache: " << ec.message() << "\n";
+            m_misses++;
+            count(kMissesFile);
+            return false;
+        }
+
+        // 3. Mark the entry as recently used, so the pruner keeps it.
+        int fd;
+        if (!llvm::sys::fs::openFileForRead(entry, fd)) {
+            llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+            llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+        }
+    }
+
+    m_hits++;
+    count(kHitsFile);
+    return true;
+}
+
+void ObjectCache::store(const std::string& key, const std::vector<std::string>& outputs, std::ostream& diagnostics) {
+    if (std::error_code ec = llvm::sys::fs::create_directories(m_directory)) {
+        diagnostics << "Warning: Could not create cache directory '" << m_directory << "': " << ec.message() << "\n";
+        return;
+    }
+
+    for (size_t i = 0; i < outputs.size(); i++) {
+        // 1. Copy into a temporary file next to the entry. Its name starts
+        //    with "llvmcache-" too, so leftovers from a crash get pruned.
+        llvm::SmallString<256> model(m_directory);
+        llvm::sys::path::append(model, "llvmcache-tmp-%%%%%%%%%%%%");
+        int fd;
+        llvm::SmallString<256> temporary;
+        if (std::error_code ec = llvm::sys::fs::createUniqueFile(model, fd, temporary)) {
+            diagnostics << "Warning: Could not write to the cache: " << ec.message() << "\n";
+            return;
+        }
+        std::error_code ec = llvm::sys::fs::copy_file(outputs[i], fd);
+        llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+        // 2. Renaming is atomic: readers see the old entry, the new one or none.
+        //    If another process stored the same entry first, its bytes are the same.
+        if (!ec) {
+            ec = llvm::sys::fs::rename(temporary, entryPath(key, i));
+        }
+        if (ec) {
+            diagnostics << "Warning: Could not write to the cache: " << ec.message() << "\n";
+            llvm::sys::fs::remove(temporary);
+            return;
+        }
+    }
+
+    // 3. Evict least recently used entries if we have grown past the limit.
+    //    Only done after a miss, since a hit doesn't make the cache bigger.
+    llvm::CachePruningPolicy policy;
+    policy.Interval = std::chrono::seconds(0); // Check the size every time
+    policy.MaxSizeBytes = m_max_bytes;
+    llvm::pruneCache(m_directory, policy);
+}
+
+void ObjectCache::printStats(std::ostream& out) const {
+    uint64_t entries = 0, bytes = 0;
+    std::error_code ec;
+    for (llvm::sys::fs::directory_iterator it(m_directory, ec), end; it != end && !ec; it.increment(ec)) {
+        llvm::StringRef name = llvm::sys::path::filename(it->path());
+        if (!name.starts_with("llvmcache-") || name.starts_with("llvmcache-tmp-")) continue;
+        if (auto status = it->status()) {
+            entries++;
+            bytes += status->getSize();
+        }
+    }
+
+    auto counter = [&](const char* counterFile) {
+        llvm::SmallString<256> path(m_directory);
+        llvm::sys::path::append(path, counterFile);
+        uint64_t size = 0;
+        return llvm::sys::fs::file_size(path, size) ? uint64_t(0) : size;
+    };
+    uint64_t hits = counter(kHitsFile), misses = counter(kMissesFile);
+    double lookups = static_cast<double>(hits + misses);
+
+    out << "Object cache '" << m_directory << "':\n"
+        << std::fixed << std::setprecision(1)
+        << "  Entries      " << std::setw(12) << entries << "\n"
+        << "  Size (MB)    " << std::setw(12) << bytes / 1e6 << "  (limit " << m_max_bytes / 1e6 << ")\n"
+        << "  Hits         " << std::setw(12) << hits << "  (this run: " << m_hits << ")\n"
+        << "  Misses       " << std::setw(12) << misses << "  (this run: " << m_misses << ")\n"
+        << "  Hit rate (%) " << std::setw(12) << (lookups > 0 ? 100.0 * hits / lookups : 0.0) << "\n";
+}
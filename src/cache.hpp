@@ -0,0 +1,53 @@
+#pragma once
+#include "options.hpp"
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- Object File Cache ---
+// A directory of object files, addressed by a SHA-256 of everything that
+// decides their bytes: the source text, the compiler and LLVM versions, the
+// target triple, the resolved CPU and features, and the code generation flags.
+// A hit copies the cached objects to the outputs without lexing, parsing or
+// generating any code.
+//
+// Many `ac` processes may share one cache directory:
+//   - entries are written to a temporary file and renamed into place, so a
+//     reader sees either the whole object or nothing;
+//   - eviction is LLVM's pruneCache: least recently used entries go first
+//     once the directory is over --cache-size (or 75% of the free disk space),
+//     and entries unused for a week always go;
+//   - the hit and miss counters are files that grow by one byte per lookup,
+//     appended with O_APPEND, so concurrent updates need no lock.
+class ObjectCache {
+public:
+    // Nothing is touched on disk until the first lookup.
+    ObjectCache(std::string directory, uint64_t maxBytes);
+
+    // The cache key (a hex SHA-256) for compiling `source` with `options`.
+    std::string key(std::string_view source, const CompileOptions& options) const;
+
+    // On a hit, copies the cached objects for `key` to `outputs` (one per
+    // --codegen-threads partition) and returns true.
+    bool fetch(const std::string& key, const std::vector<std::string>& outputs, std::ostream& diagnostics);
+
+    // Adds freshly written `outputs` to the cache, then evicts old entries if
+    // it has grown too big. Failing to cache is only a warning.
+    void store(const std::string& key, const std::vector<std::string>& outputs, std::ostream& diagnostics);
+
+    // Prints the size of the cache and the hit/miss counts, all-time and for this process.
+    void printStats(std::ostream& out) const;
+
+private:
+    // pruneCache only ever deletes files whose names start with "llvmcache-".
+    std::string entryPath(const std::string& key, size_t partition) const;
+    void count(const char* counterFile);
+
+    std::string m_directory;
+    uint64_t m_max_bytes;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
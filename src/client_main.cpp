@@ -0,0 +1,55 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include "options.hpp"
+#include "server.hpp"
+
+// --- ac_client ---
+// Takes the same arguments as `ac`. When a compile server is running
+// ($ATHERIA_SERVER or --connect=<socket>) and the command can be done there,
+// the server compiles it; otherwise this process becomes a plain `ac`.
+//
+// It is built from the option parser and the server protocol alone, without
+// LLVM, so that starting it costs about as much as starting any small
+// program. An `ac --connect` client has to load all of LLVM first, which is
+// most of what the server is there to save.
+
+// The compiler to fall back on: $ATHERIA_AC, or the `ac` next to this program.
+static std::string compilerPath() {
+    if (const char* path = std::getenv("ATHERIA_AC"); path && *path) {
+        return path;
+    }
+    char self[PATH_MAX];
+    ssize_t length = ::readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (length <= 0) {
+        return "ac";
+    }
+    std::string directory(self, static_cast<size_t>(length));
+    return directory.substr(0, directory.rfind('/') + 1) + "ac";
+}
+
+int main(int argc, char** argv) {
+    // 1. Forward the command if we can. Bad command lines are left for `ac`
+    //    to complain about, so the diagnostics are the same either way.
+    CompileOptions options;
+    applyEnvironment(options);
+    std::ostream discard(nullptr);
+    if (parseCommandLine(argc, argv, options, discard) && !options.connectSocket.empty() && canForward(options)) {
+        int exitCode;
+        if (forwardCommandLine(options, argc, argv, exitCode)) {
+            return exitCode;
+        }
+    }
+
+    // 2. No server, or a command that has to run here: be `ac`.
+    std::string compiler = compilerPath();
+    ::execv(compiler.c_str(), argv);
+    std::cerr << "Error: Could not run the compiler '" << compiler << "': " << std::strerror(errno) << std::endl;
+    return 1;
+}
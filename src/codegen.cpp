@@ -1,333 +1,917 @@
 #include "codegen.hpp"
+#include <charconv>
 #include <iostream>
 
 // All the necessary LLVM headers for the whole process
 #include "llvm/IR/Verifier.h"
 #include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/SubtargetFeature.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/raw_os_ostream.h"
 #include "llvm/MC/TargetRegistry.h"
+#include "llvm/MC/MCSubtargetInfo.h"
 #include "llvm/IR/LegacyPassManager.h"
-
-CodeGen::CodeGen() {
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/StandardInstrumentations.h"
+#include "llvm/Pass.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/ThinLTOBitcodeWriter.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/Support/PGOOptions.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/xxhash.h"
+#include "llvm/ADT/StringExtras.h"
+#include <filesystem>
+#include <optional>
+#include <mutex>
+#include <unordered_map>
+
+CodeGen::CodeGen(const CompileOptions& options, std::ostream& output, std::ostream& diagnostics)
+    : m_output(output), m_diagnostics(diagnostics), m_options(options) {
     // Initialize the core LLVM components
     m_context = std::make_unique<llvm::LLVMContext>();
     m_module = std::make_unique<llvm::Module>("AtheriaModule", *m_context);
-    m_builder = std::make_unique<llvm::IRBuilder<>>(*m_context);
+
+    // Problems LLVM itself finds (a profile that can't be read or no longer
+    // matches the code, ...) go where ours go. Left alone, LLVM would print
+    // them to stderr and exit on errors, taking a compile server with it.
+    m_context->setDiagnosticHandlerCallBack(handleLlvmDiagnostic, this);
+
+    // Giving every temporary a unique name ("addtmp", "addtmp1", ...) costs
+    // a string and a symbol table entry per instruction. Like clang, only do
+    // it when somebody is going to read the IR.
+    m_context->setDiscardValueNames(!m_options.dumpIr && !m_options.writesIr());
+
+    // ThinLTO tells the private symbols (string literals) of different
+    // modules apart by their source file, so IR that is linked later needs
+    // the real name. Objects keep the fixed one, so they don't depend on paths.
+    if (m_options.writesIr() && !m_options.inputs.empty()) {
+        m_module->setSourceFileName(m_options.inputs[0]);
+    }
+
+    createTargetMachine();
+}
+
+void CodeGen::handleLlvmDiagnostic(const llvm::DiagnosticInfo& info, void* context) {
+    CodeGen& self = *static_cast<CodeGen*>(context);
+    std::string message;
+    llvm::raw_string_ostream stream(message);
+    llvm::DiagnosticPrinterRawOStream printer(stream);
+    info.print(printer);
+    stream.flush();
+
+    switch (info.getSeverity()) {
+        case llvm::DS_Error:
+            self.m_diagnostics << "CodeGen Error: " << message << "\n";
+            self.m_llvm_error = true;
+            break;
+        case llvm::DS_Warning:
+            self.m_diagnostics << "Warning: " << message << "\n";
+            break;
+        default:
+            break; // Remarks and notes are only wanted when asked for
+    }
+}
+
+CodeGen::~CodeGen() {
+    // Everything built for the target must be gone before the target is reused.
+    m_module.reset();
+    m_context.reset();
+    returnTargetMachine(std::move(m_target_machine), m_target_key);
+}
+
+// Maps our -O level onto the backend's code generation level.
+static llvm::CodeGenOptLevel toCodeGenOptLevel(OptLevel level) {
+    switch (level) {
+        case OptLevel::O0: return llvm::CodeGenOptLevel::None;
+        case OptLevel::O1: return llvm::CodeGenOptLevel::Less;
+        case OptLevel::O2: return llvm::CodeGenOptLevel::Default;
+        case OptLevel::O3: return llvm::CodeGenOptLevel::Aggressive;
+        case OptLevel::Os: return llvm::CodeGenOptLevel::Default;
+    }
+    return llvm::CodeGenOptLevel::None;
+}
+
+// Maps our -O level onto the optimizer's.
+static llvm::OptimizationLevel toOptimizationLevel(OptLevel level) {
+    switch (level) {
+        case OptLevel::O0: return llvm::OptimizationLevel::O0;
+        case OptLevel::O1: return llvm::OptimizationLevel::O1;
+        case OptLevel::O2: return llvm::OptimizationLevel::O2;
+        case OptLevel::O3: return llvm::OptimizationLevel::O3;
+        case OptLevel::Os: return llvm::OptimizationLevel::Os;
+    }
+    return llvm::OptimizationLevel::O0;
+}
+
+// The host CPU and its features, for -march=native. Asking the OS is not
+// free, so it is done once per process and shared by every CodeGen.
+struct HostCpu {
+    std::string name;
+    std::vector<std::string> features; // "+avx2", "-sse4a", ...
+};
+
+static const HostCpu& hostCpu() {
+    static const HostCpu host = [] {
+        HostCpu result;
+        result.name = llvm::sys::getHostCPUName().str();
+
+        llvm::StringMap<bool> hostFeatures;
+        if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+            for (const auto& feature : hostFeatures) {
+                result.features.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+            }
+        }
+        return result;
+    }();
+    return host;
+}
+
+void resolveTargetCpu(const CompileOptions& options, std::string& cpu, std::string& features) {
+    llvm::SubtargetFeatures featureList;
+
+    if (options.cpu == "native") {
+        cpu = hostCpu().name;
+        for (const std::string& feature : hostCpu().features) {
+            featureList.AddFeature(feature);
+        }
+    } else {
+        cpu = options.cpu;
+    }
+
+    // Explicit -mattr flags come last so they override what the host reported.
+    llvm::SubtargetFeatures requested(options.features);
+    for (const auto& feature : requested.getFeatures()) {
+        featureList.AddFeature(feature);
+    }
+
+    features = featureList.getString();
+}
+
+// --- TargetMachine Pool ---
+// Building a TargetMachine means parsing the target's CPU and feature tables,
+// which costs about as much as compiling a small file. A TargetMachine is
+// only used by one compilation at a time, but nothing stops the next one from
+// using it again, so finished CodeGens put theirs back here, keyed by
+// everything they were created from. This matters for the compile server,
+// which compiles file after file in one process.
+static std::mutex targetPoolMutex;
+static std::unordered_multimap<std::string, std::unique_ptr<llvm::TargetMachine>> targetPool;
+static constexpr size_t kMaxPooledPerKey = 16; // About as many as run at once
+
+static std::unique_ptr<llvm::TargetMachine> takeTargetMachine(const std::string& key) {
+    std::lock_guard<std::mutex> lock(targetPoolMutex);
+    auto it = targetPool.find(key);
+    if (it == targetPool.end()) {
+        return nullptr;
+    }
+    std::unique_ptr<llvm::TargetMachine> targetMachine = std::move(it->second);
+    targetPool.erase(it);
+    return targetMachine;
+}
+
+void CodeGen::returnTargetMachine(std::unique_ptr<llvm::TargetMachine> targetMachine, const std::string& key) {
+    if (!targetMachine) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(targetPoolMutex);
+    if (targetPool.count(key) < kMaxPooledPerKey) {
+        targetPool.emplace(key, std::move(targetMachine));
+    }
+}
+
+void CodeGen::createTargetMachine() {
+    // The target registries are process-wide, so only initialize them once,
+    // however many files (and threads) are being compiled.
+    static std::once_flag targetsInitialized;
+    std::call_once(targetsInitialized, [] {
+        llvm::InitializeAllTargetInfos();
+        llvm::InitializeAllTargets();
+        llvm::InitializeAllTargetMCs();
+        llvm::InitializeAllAsmParsers();
+        llvm::InitializeAllAsmPrinters();
+    });
+
+    auto targetTriple = llvm::sys::getDefaultTargetTriple();
+    m_module->setTargetTriple(targetTriple);
+
+    resolveTargetCpu(m_options, m_cpu, m_features);
+
+    // A TargetMachine for the same target that an earlier compilation is done with.
+    m_target_key = targetTriple + "|" + m_cpu + "|" + m_features + "|" + optLevelToString(m_options.optLevel);
+    m_target_machine = takeTargetMachine(m_target_key);
+    if (m_target_machine) {
+        m_module->setDataLayout(m_target_machine->createDataLayout());
+        return;
+    }
+
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+
+    if (!target) {
+        m_diagnostics << "CodeGen Error: " << error << "\n";
+        return;
+    }
+
+    // Catch typos like -mcpu=skylake-avx52 instead of silently falling back to generic.
+    if (m_cpu != "generic") {
+        std::unique_ptr<llvm::MCSubtargetInfo> subtarget(target->createMCSubtargetInfo(targetTriple, "", ""));
+        if (subtarget && !subtarget->isCPUStringValid(m_cpu)) {
+            m_diagnostics << "CodeGen Error: Unknown CPU '" << m_cpu << "' for target '" << targetTriple << "'\n";
+            return;
+        }
+    }
+
+    llvm::TargetOptions opt;
+    auto rm = llvm::Reloc::Model::PIC_;
+    m_target_machine.reset(target->createTargetMachine(targetTriple, m_cpu, m_features, opt, rm, std::nullopt,
+                                                       toCodeGenOptLevel(m_options.optLevel)));
+
+    m_module->setDataLayout(m_target_machine->createDataLayout());
 }
 
 // A helper function to convert our language's type names into LLVM's type objects
 llvm::Type* CodeGen::getLlvmType(const Token& token) {
-    if (token.value == "int32_t") {
-        return m_builder->getInt32Ty();
+    if (token.symbol == sym::Int32) {
+        return llvm::Type::getInt32Ty(*m_context);
     }
     // You can add more types like "float", "bool", etc. here later
-    std::cerr << "CodeGen Error: Unknown type '" << token.value << "'\n";
+    errorAt(token) << "Unknown type '" << text(token) << "'\n";
     return nullptr;
 }
 
-// The main entry point for the code generator
-void CodeGen::generate(ProgramNode* program) {
-    program->accept(*this);
+// Starts a "CodeGen Error at line:column: " diagnostic; the caller finishes the message.
+std::ostream& CodeGen::errorAt(const Token& token) {
+    return m_diagnostics << "CodeGen Error at " << token.line << ":" << token.column << ": ";
 }
 
-// --- Visitor Implementations: Where the Magic Happens ---
-
-void CodeGen::visit(ProgramNode* node) {
-    // A program is just a list of functions, so we visit each one.
-    for (const auto& func : node->functions) {
-        func->accept(*this);
+// The main entry point for the code generator
+bool CodeGen::generate(const Ast& ast) {
+    m_ast = &ast;
+    m_function_table.pushScope();
+    FunctionState state(*m_context);
+    bool ok = true;
+    for (NodeIndex function : ast.program(ast.root()).functions) {
+        if (!lowerFunction(state, ast.function(function))) {
+            ok = false;
+        }
     }
+    m_function_table.popScope();
+    m_ast = nullptr;
+    return ok;
 }
 
-void CodeGen::visit(FunctionDefinitionNode* node) {
-    // ---- 1. SETUP ----
-    // Clear the symbol table for this new function's scope. This is crucial
-    // so that variables from one function don't leak into another.
-    m_symbol_table.clear();
+// --- Lowering: Where the Magic Happens ---
+// Each node kind is one case of a switch, and every value is returned
+// straight to the caller that needs it.
+
+void CodeGen::FunctionState::start(llvm::Function* newFunction) {
+    function = newFunction;
+    ssa.clear();
+    nextVariable = 0;
+    returned = nullptr;
+}
 
-    // ---- 2. CREATE FUNCTION SIGNATURE ----
+bool CodeGen::lowerFunction(FunctionState& state, const FunctionDefinitionNode& node) {
+    // ---- 1. CREATE FUNCTION SIGNATURE ----
     // Collect the LLVM types of the parameters
     std::vector<llvm::Type*> paramTypes;
-    for (const auto& param : node->parameters) {
-        llvm::Type* type = getLlvmType(param->type);
-        if (!type) return; // Error was already printed by getLlvmType
+    for (NodeIndex param : node.parameters) {
+        llvm::Type* type = getLlvmType(m_ast->parameter(param).type);
+        if (!type) return false; // Error was already printed by getLlvmType
         paramTypes.push_back(type);
     }
 
     // Get the return type
-    llvm::Type* returnType = getLlvmType(node->returnType);
-    if (!returnType) return;
+    llvm::Type* returnType = getLlvmType(node.returnType);
+    if (!returnType) return false;
+
+    // Only `export` functions (and main, which the C runtime calls) can be
+    // called from outside the object file. The rest get internal linkage,
+    // which lets the optimizer inline a function into its only caller and
+    // drop it, drop ones that are never called, and pick their calling
+    // convention: fastcc, and no address anyone could compare.
+    bool isMain = node.functionName.symbol == sym::Main;
+    if (isMain && (node.qualifiers & qualifier::Static)) {
+        errorAt(node.functionName) << "'main' can't be static\n";
+        return false;
+    }
+    bool exported = node.isExported() || isMain;
 
     // Create the actual LLVM function type and function object
     llvm::FunctionType* funcType = llvm::FunctionType::get(returnType, paramTypes, false);
-    llvm::Function* func = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, node->functionName.value, m_module.get());
+    llvm::Function* func = llvm::Function::Create(funcType, exported ? llvm::Function::ExternalLinkage : llvm::Function::InternalLinkage,
+                                                  text(node.functionName), m_module.get());
+    if (!exported) {
+        func->setCallingConv(llvm::CallingConv::Fast);
+        func->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        func->setDSOLocal(true);
+    }
+    m_function_table.declare(node.functionName.symbol, func);
 
-    // ---- 3. CREATE FUNCTION BODY ----
-    // Create the "entry" block for the function and tell the IR builder to start writing code here
+    // Record the CPU on the function itself, like clang does. The optimizer's
+    // cost models and the inliner read these per-function attributes.
+    func->addFnAttr("target-cpu", m_cpu);
+    if (!m_features.empty()) {
+        func->addFnAttr("target-features", m_features);
+    }
+
+    // ---- 2. CREATE FUNCTION BODY ----
+    // Create the "entry" block for the function and tell the IR builder to start writing code here.
+    // Nothing ever jumps back to it, so it is sealed right away (see SsaBuilder).
+    state.start(func);
     llvm::BasicBlock* block = llvm::BasicBlock::Create(*m_context, "entry", func);
-    m_builder->SetInsertPoint(block);
+    state.builder.SetInsertPoint(block);
+    state.ssa.sealBlock(block);
+
+    // ---- 3. OPEN THE FUNCTION'S SCOPE ----
+    state.variables.pushScope();
 
     // ---- 4. PROCESS PARAMETERS ----
-    // Now we handle the incoming arguments, giving them names and storing them
-    // on the stack so they can be used like regular variables.
-    auto param_it = node->parameters.begin();
+    // The incoming arguments are the parameters' first values; like any
+    // other variable they get a new SSA value when they are assigned.
+    auto param_it = node.parameters.begin();
     for (auto& arg : func->args()) {
-        arg.setName((*param_it)->name.value);
-
-        // Create a mutable variable on the stack (an "alloca") for the parameter
-        llvm::Type* paramLlvmType = getLlvmType((*param_it)->type);
-        llvm::Value* alloca = m_builder->CreateAlloca(paramLlvmType, nullptr, arg.getName());
-
-        // Store the initial argument value into our new stack variable
-        m_builder->CreateStore(&arg, alloca);
-
-        // Add the stack variable to our symbol table so we can find it by name later
-        m_symbol_table[std::string(arg.getName())] = alloca;
-
+        ParameterNode param = m_ast->parameter(*param_it);
+        arg.setName(text(param.name));
+        declareVariable(state, param.name, &arg);
         param_it++;
     }
 
     // ---- 5. GENERATE CODE FOR STATEMENTS ----
-    // Visit each statement in the function's body
-    for (const auto& stmt : node->body) {
-        stmt->accept(*this);
+    // The first error ends the function: what follows would only report
+    // errors that come from the first one.
+    bool ok = true;
+    for (NodeIndex stmt : node.body) {
+        if (!lowerStatement(state, stmt)) {
+            ok = false;
+            break;
+        }
+    }
+    if (ok && !state.returned) {
+        errorAt(node.functionName) << "Function '" << text(node.functionName) << "' does not end with a 'return'\n";
+        ok = false;
     }
 
     // ---- 6. VERIFICATION ----
-    // Ask LLVM to verify that our generated function is valid. This catches many bugs.
-    llvm::verifyFunction(*func);
-}
-
-
-// A NumberLiteral simply becomes an LLVM integer constant.
-void CodeGen::visit(NumberLiteralNode* node) {
-    int val = std::stoi(node->value.value);
-    m_last_value = m_builder->getInt32(val);
-}
+    // Ask LLVM to verify that our generated function is valid. Anything it
+    // finds is a bug in the code generator, not in the program.
+    if (ok) {
+        std::string problems;
+        llvm::raw_string_ostream stream(problems);
+        if (llvm::verifyFunction(*func, &stream)) {
+            m_diagnostics << "CodeGen Error: Generated invalid IR for '" << text(node.functionName) << "': " << stream.str();
+            ok = false;
+        }
+    }
 
-// A StringLiteral becomes a global constant string pointer.
-void CodeGen::visit(StringLiteralNode* node) {
-    m_last_value = m_builder->CreateGlobalStringPtr(node->value.value, "str_literal");
+    // ---- 7. CLOSE THE SCOPE ----
+    // A function with errors keeps its declaration, so that calls to it
+    // don't report errors of their own.
+    state.variables.popScope();
+    if (!ok) {
+        func->deleteBody();
+    }
+    return ok;
 }
 
-
-// To use a variable, we find it in the symbol table and load its value from the stack.
-void CodeGen::visit(VariableNode* node) {
-    // Look up the variable's memory location (the AllocaInst*) in the symbol table.
-    llvm::Value* ptr = m_symbol_table[node->name.value];
-    if (!ptr) {
-        std::cerr << "CodeGen Error: Unknown variable name '" << node->name.value << "'\n";
-        m_last_value = nullptr;
-        return;
+bool CodeGen::lowerStatement(FunctionState& state, NodeIndex index) {
+    if (state.returned) {
+        errorAt(*state.returned) << "Statements after 'return' are never run\n";
+        return false;
     }
-    // An AllocaInst* is a pointer. We need to get the type it's pointing to.
-    llvm::Type* type = static_cast<llvm::AllocaInst*>(ptr)->getAllocatedType();
 
-    // `CreateLoad` generates the instruction to load the value from memory.
-    m_last_value = m_builder->CreateLoad(type, ptr, node->name.value);
-}
+    switch (m_ast->kind(index)) {
+        case NodeKind::FunctionCallStatement: {
+            // A call whose value is discarded; 'print' is the built-in one.
+            FunctionCallNode call = m_ast->call(index);
+            if (call.functionName.symbol == sym::Print) {
+                return lowerPrint(state, call);
+            }
+            return lowerCall(state, call) != nullptr;
+        }
 
-// For a binary operation, we generate code for both sides, then create the final instruction.
-void CodeGen::visit(BinaryOpNode* node) {
-    // Recursively generate code for the left and right hand sides
-    node->left->accept(*this);
-    llvm::Value* L = m_last_value;
+        case NodeKind::ReturnStatement: {
+            // 1. Evaluate the returned expression; it must match the function's return type.
+            ReturnStatementNode node = m_ast->returnStatement(index);
+            llvm::Value* value = lowerExpression(state, node.returnValue);
+            if (!value) return false;
+            if (value->getType() != state.function->getReturnType()) {
+                errorAt(node.keyword) << "Returned value does not match the return type of '"
+                                      << state.function->getName().str() << "'\n";
+                return false;
+            }
+
+            // 2. Create the LLVM 'ret' instruction. It ends the block.
+            state.builder.CreateRet(value);
+            state.returned = &node.keyword;
+            return true;
+        }
 
-    node->right->accept(*this);
-    llvm::Value* R = m_last_value;
+        case NodeKind::AutoStatement: {
+            // 1. Evaluate the initializer expression on the right side of the '='.
+            AutoStatementNode node = m_ast->autoStatement(index);
+            llvm::Value* initial_value = lowerExpression(state, node.initializer);
+            if (!initial_value) return false;
 
-    if (!L || !R) {
-        m_last_value = nullptr;
-        return;
-    }
+            // 2. Declare the variable. Its type is the initializer's type, the
+            // "type inference" of 'auto', and its first value is the initializer itself.
+            declareVariable(state, node.name, initial_value);
+            return true;
+        }
+
+        case NodeKind::AssignmentStatement: {
+            // 1. The variable must already exist; assignment doesn't declare one.
+            AssignmentStatementNode node = m_ast->assignment(index);
+            LocalVariable* variable = state.variables.lookup(node.name.symbol);
+            if (!variable) {
+                errorAt(node.name) << "Assignment to undeclared variable '" << text(node.name) << "'\n";
+                return false;
+            }
+
+            // 2. Evaluate the new value. It must have the type the variable was declared with.
+            llvm::Value* value = lowerExpression(state, node.value);
+            if (!value) return false;
+            if (value->getType() != variable->type) {
+                errorAt(node.name) << "Cannot assign a value of a different type to variable '" << text(node.name) << "'\n";
+                return false;
+            }
+
+            // 3. From here on, reads of the variable see the new value.
+            state.ssa.writeVariable(variable->id, state.builder.GetInsertBlock(), value);
+            return true;
+        }
 
-    // Create the correct LLVM instruction based on the operator token
-    switch (node->op.type) {
-        case TokenType::PLUS:
-            m_last_value = m_builder->CreateAdd(L, R, "addtmp");
-            break;
-        case TokenType::MINUS:
-            m_last_value = m_builder->CreateSub(L, R, "subtmp");
-            break;
-        case TokenType::STAR:
-            m_last_value = m_builder->CreateMul(L, R, "multmp");
-            break;
-        case TokenType::SLASH:
-            m_last_value = m_builder->CreateSDiv(L, R, "divtmp"); // SDiv = Signed Divide
-            break;
         default:
-            std::cerr << "CodeGen Error: Invalid binary operator\n";
-            m_last_value = nullptr;
+            // The parser only puts statements in function bodies.
+            m_diagnostics << "CodeGen Error: Unexpected node in a function body\n";
+            return false;
     }
 }
 
-
-// Calling a function is complex because we need to handle different argument types.
-void CodeGen::visit(FunctionCallStatementNode* node) {
-    // The only built-in function we have right now is 'print'
-    if (node->functionName.value == "print") {
-        // Look up the C 'printf' function, or declare it if it doesn't exist
-        llvm::Function* printf_func = m_module->getFunction("printf");
-        if (!printf_func) {
-            llvm::PointerType* printf_arg_type = m_builder->getInt8Ty()->getPointerTo();
-            llvm::FunctionType* printf_type = llvm::FunctionType::get(m_builder->getInt32Ty(), printf_arg_type, true);
-            printf_func = llvm::Function::Create(printf_type, llvm::Function::ExternalLinkage, "printf", m_module.get());
+llvm::Value* CodeGen::lowerExpression(FunctionState& state, NodeIndex index) {
+    switch (m_ast->kind(index)) {
+        case NodeKind::NumberLiteral: {
+            // A NumberLiteral simply becomes an LLVM integer constant.
+            const Token& literal = m_ast->leafToken(index);
+            std::string_view digits = text(literal);
+            int32_t val = 0;
+            auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), val);
+            if (ec != std::errc() || end != digits.data() + digits.size()) {
+                errorAt(literal) << "Number literal '" << digits << "' does not fit in int32_t\n";
+                return nullptr;
+            }
+            return state.builder.getInt32(val);
         }
 
-        if (node->arguments.empty()) {
-            std::cerr << "CodeGen Error: 'print' function requires one argument.\n";
-            return;
+        case NodeKind::Constant:
+            // A value the simplifier already computed.
+            return state.builder.getInt32(m_ast->constant(index));
+
+        case NodeKind::StringLiteral:
+            // A StringLiteral becomes a global constant string pointer.
+            return state.builder.CreateGlobalStringPtr(text(m_ast->leafToken(index)), "str_literal");
+
+        case NodeKind::Variable: {
+            // To use a variable, we find its declaration and ask for the value it holds at this point.
+            const Token& name = m_ast->leafToken(index);
+            LocalVariable* variable = state.variables.lookup(name.symbol);
+            if (!variable) {
+                errorAt(name) << "Unknown variable name '" << text(name) << "'\n";
+                return nullptr;
+            }
+            return state.ssa.readVariable(variable->id, variable->type, state.builder.GetInsertBlock());
         }
 
-        // Generate the code for the argument expression
-        node->arguments[0]->accept(*this);
-        llvm::Value* arg_value = m_last_value;
-
-        // --- NEW: Handle printing integers vs strings ---
-        std::vector<llvm::Value*> printf_args;
-        if (arg_value->getType()->isPointerTy()) {
-            // It's a string. We need the format string "%s\n"
-            llvm::Value* format_str = m_builder->CreateGlobalStringPtr("%s\n", "fmt_str_s");
-            printf_args.push_back(format_str);
-            printf_args.push_back(arg_value);
-        } else if (arg_value->getType()->isIntegerTy()) {
-            // It's an integer. We need the format string "%d\n"
-            llvm::Value* format_str = m_builder->CreateGlobalStringPtr("%d\n", "fmt_str_d");
-            printf_args.push_back(format_str);
-            printf_args.push_back(arg_value);
-        } else {
-             std::cerr << "CodeGen Error: 'print' can only handle strings and integers for now.\n";
-             return;
+        case NodeKind::BinaryOp: {
+            // Generate code for both sides, then create the final instruction.
+            BinaryOpNode node = m_ast->binaryOp(index);
+            llvm::Value* L = lowerExpression(state, node.left);
+            if (!L) return nullptr;
+            llvm::Value* R = lowerExpression(state, node.right);
+            if (!R) return nullptr;
+            if (!L->getType()->isIntegerTy() || !R->getType()->isIntegerTy()) {
+                errorAt(node.op) << "Operator '" << text(node.op) << "' needs integer operands\n";
+                return nullptr;
+            }
+
+            // Create the correct LLVM instruction based on the operator token
+            switch (node.op.type) {
+                case TokenType::PLUS: return state.builder.CreateAdd(L, R, "addtmp");
+                case TokenType::MINUS: return state.builder.CreateSub(L, R, "subtmp");
+                case TokenType::STAR: return state.builder.CreateMul(L, R, "multmp");
+                case TokenType::SLASH: return state.builder.CreateSDiv(L, R, "divtmp"); // SDiv = Signed Divide
+                default:
+                    errorAt(node.op) << "Invalid binary operator\n";
+                    return nullptr;
+            }
         }
 
-        m_builder->CreateCall(printf_func, printf_args);
-        m_last_value = nullptr; // A print statement produces no value
-        return;
-    }
+        case NodeKind::ShiftLeft: {
+            // x * 2^n, strength-reduced by the simplifier.
+            ShiftNode node = m_ast->shift(index);
+            llvm::Value* value = lowerExpression(state, node.operand);
+            if (!value) return nullptr;
+            return state.builder.CreateShl(value, node.amount, "shltmp");
+        }
 
-    std::cerr << "CodeGen Error: Unknown function called '" << node->functionName.value << "'\n";
-}
+        case NodeKind::DivideByPowerOfTwo: {
+            // x / 2^n. Division rounds toward zero but a shift rounds down, so
+            // negative values are first biased by 2^n - 1 (from the sign bits).
+            ShiftNode node = m_ast->shift(index);
+            llvm::Value* value = lowerExpression(state, node.operand);
+            if (!value) return nullptr;
+            llvm::Value* sign = state.builder.CreateAShr(value, 31, "signtmp");
+            llvm::Value* bias = state.builder.CreateLShr(sign, 32 - node.amount, "biastmp");
+            llvm::Value* biased = state.builder.CreateAdd(value, bias, "biasedtmp");
+            return state.builder.CreateAShr(biased, node.amount, "divtmp");
+        }
 
-// Add this new function to codegen.cpp
-void CodeGen::visit(ReturnStatementNode* node) {
-    // 1. Visit the expression to generate its code and get its value
-    node->returnValue->accept(*this);
-    llvm::Value* valueToReturn = m_last_value;
+        case NodeKind::FunctionCallExpression: {
+            FunctionCallNode call = m_ast->call(index);
+            if (call.functionName.symbol == sym::Print) {
+                errorAt(call.functionName) << "'print' has no value\n";
+                return nullptr;
+            }
+            return lowerCall(state, call);
+        }
 
-    // 2. Create the LLVM 'ret' instruction
-    if (valueToReturn) {
-        m_builder->CreateRet(valueToReturn);
+        default:
+            m_diagnostics << "CodeGen Error: Unexpected node in an expression\n";
+            return nullptr;
     }
 }
 
-void CodeGen::visit(AutoStatementNode* node) {
-    // 1. Evaluate the initializer expression on the right side of the '='.
-    // After this call, the result will be in m_last_value.
-    node->initializer->accept(*this);
-    llvm::Value* initial_value = m_last_value;
-
-    if (!initial_value) {
-        std::cerr << "CodeGen Error: Invalid initializer for variable '" << node->name.value << "'.\n";
-        return;
+// 'print' is the one built-in function: a printf whose format depends on the argument's type.
+bool CodeGen::lowerPrint(FunctionState& state, const FunctionCallNode& call) {
+    // Look up the C 'printf' function, or declare it if it doesn't exist
+    llvm::Function* printf_func = m_module->getFunction("printf");
+    if (!printf_func) {
+        llvm::PointerType* printf_arg_type = state.builder.getInt8Ty()->getPointerTo();
+        llvm::FunctionType* printf_type = llvm::FunctionType::get(state.builder.getInt32Ty(), printf_arg_type, true);
+        printf_func = llvm::Function::Create(printf_type, llvm::Function::ExternalLinkage, "printf", m_module.get());
     }
 
-    // 2. Get the type of the variable from the initializer's value.
-    // This is "type inference" - the magic of 'auto'!
-    llvm::Type* var_type = initial_value->getType();
-
-    // 3. Allocate memory on the stack for the new variable.
-    // CreateAlloca reserves space in the current function's stack frame.
-    llvm::Value* alloca = m_builder->CreateAlloca(var_type, nullptr, node->name.value);
+    if (call.arguments.size() != 1) {
+        errorAt(call.functionName) << "'print' function requires one argument.\n";
+        return false;
+    }
 
-    // 4. Store the initial value into the allocated memory.
-    m_builder->CreateStore(initial_value, alloca);
+    // Generate the code for the argument expression
+    llvm::Value* arg_value = lowerExpression(state, call.arguments[0]);
+    if (!arg_value) return false;
+
+    // Strings print with "%s\n", integers with "%d\n".
+    llvm::Value* format_str;
+    if (arg_value->getType()->isPointerTy()) {
+        format_str = state.builder.CreateGlobalStringPtr("%s\n", "fmt_str_s");
+    } else if (arg_value->getType()->isIntegerTy()) {
+        format_str = state.builder.CreateGlobalStringPtr("%d\n", "fmt_str_d");
+    } else {
+        errorAt(call.functionName) << "'print' can only handle strings and integers for now.\n";
+        return false;
+    }
 
-    // 5. Add the new variable to our symbol table so we can find it later.
-    // We store the variable's name and a pointer to its memory location (the alloca).
-    m_symbol_table[node->name.value] = alloca;
+    state.builder.CreateCall(printf_func, {format_str, arg_value});
+    return true;
 }
-// Add this new function to the end of src/codegen.cpp
-void CodeGen::visit(FunctionCallExpressionNode* node) {
-    // 1. Look up the function in the module's symbol table.
-    llvm::Function* calleeFunc = m_module->getFunction(node->functionName.value);
+
+llvm::Value* CodeGen::lowerCall(FunctionState& state, const FunctionCallNode& call) {
+    // 1. Look up the function in our function table.
+    llvm::Function** callee = m_function_table.lookup(call.functionName.symbol);
+    llvm::Function* calleeFunc = callee ? *callee : nullptr;
     if (!calleeFunc) {
-        std::cerr << "CodeGen Error: Unknown function referenced: " << node->functionName.value << "\n";
-        m_last_value = nullptr;
-        return;
+        errorAt(call.functionName) << "Unknown function referenced: " << text(call.functionName) << "\n";
+        return nullptr;
     }
 
     // 2. Check that the number of arguments matches what the function expects.
-    if (calleeFunc->arg_size() != node->arguments.size()) {
-        std::cerr << "CodeGen Error: Incorrect # of arguments passed to " << node->functionName.value << "\n";
-        m_last_value = nullptr;
-        return;
+    if (calleeFunc->arg_size() != call.arguments.size()) {
+        errorAt(call.functionName) << "Incorrect # of arguments passed to " << text(call.functionName) << "\n";
+        return nullptr;
     }
 
     // 3. Generate the code for each argument expression.
     std::vector<llvm::Value*> ArgsV;
-    for (const auto& arg : node->arguments) {
-        arg->accept(*this); // Visit the argument expression
-        if (!m_last_value) {
-            // An error occurred parsing one of the arguments
-            return;
+    for (uint32_t i = 0; i < call.arguments.size(); i++) {
+        llvm::Value* argument = lowerExpression(state, call.arguments[i]);
+        if (!argument) return nullptr;
+        if (argument->getType() != calleeFunc->getArg(i)->getType()) {
+            errorAt(call.functionName) << "Argument " << i + 1 << " of " << text(call.functionName) << " has the wrong type\n";
+            return nullptr;
         }
-        ArgsV.push_back(m_last_value);
+        ArgsV.push_back(argument);
     }
 
-    // 4. Create the function call instruction.
-    // The result of the call is itself an llvm::Value*, which we store.
-    m_last_value = m_builder->CreateCall(calleeFunc, ArgsV, "calltmp");
+    // 4. Create the function call instruction. Its result is the call's value.
+    //    It must use the callee's calling convention (fastcc unless exported).
+    llvm::CallInst* callInst = state.builder.CreateCall(calleeFunc, ArgsV, "calltmp");
+    callInst->setCallingConv(calleeFunc->getCallingConv());
+    return callInst;
+}
+
+void CodeGen::declareVariable(FunctionState& state, const Token& name, llvm::Value* value) {
+    SsaVariable id = state.nextVariable++;
+    state.variables.declare(name.symbol, LocalVariable{id, value->getType()});
+    state.ssa.writeVariable(id, state.builder.GetInsertBlock(), value);
 }
 // --- Boilerplate and Debugging ---
 
 void CodeGen::dump() {
-    m_module->print(llvm::errs(), nullptr);
+    llvm::raw_os_ostream stream(m_diagnostics);
+    m_module->print(stream, nullptr);
 }
 
-void CodeGen::emitObjectFile(const std::string& filename) {
-    llvm::InitializeAllTargetInfos();
-    llvm::InitializeAllTargets();
-    llvm::InitializeAllTargetMCs();
-    llvm::InitializeAllAsmParsers();
-    llvm::InitializeAllAsmPrinters();
+bool CodeGen::optimize() {
+    optimizeModule(*m_module);
+    return !m_llvm_error;
+}
 
-    auto targetTriple = llvm::sys::getDefaultTargetTriple();
-    m_module->setTargetTriple(targetTriple);
+void CodeGen::optimizeModule(llvm::Module& module) {
+    // The four analysis managers of the new pass manager. They must be declared
+    // in this order so they are destroyed in the right order.
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    // The standard instrumentation is what times each pass for --time-report
+    // and puts them in the time trace for --trace.
+    llvm::PassInstrumentationCallbacks callbacks;
+    llvm::StandardInstrumentations instrumentation(*m_context, /*DebugLogging=*/false);
+    instrumentation.registerCallbacks(callbacks, &mam);
+
+    // Giving the PassBuilder our TargetMachine lets the cost models (inliner,
+    // vectorizer, ...) see the real target instead of a generic one.
+    // -fprofile-generate inserts the counters (and the code that writes them
+    // out) before anything else; -fprofile-use attaches the counts as
+    // function entry counts and call site weights, which the inliner and
+    // the hot/cold function placement work from.
+    std::optional<llvm::PGOOptions> pgo;
+    if (m_options.profileGenerate) {
+        pgo = llvm::PGOOptions(m_options.profileRawFile, "", "", /*MemoryProfile=*/"", llvm::vfs::getRealFileSystem(), llvm::PGOOptions::IRInstr);
+    } else if (!m_options.profileUse.empty()) {
+        pgo = llvm::PGOOptions(m_options.profileUse, "", "", /*MemoryProfile=*/"", llvm::vfs::getRealFileSystem(), llvm::PGOOptions::IRUse);
+    }
 
-    std::string error;
-    auto target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+    llvm::PassBuilder passBuilder(m_target_machine.get(), llvm::PipelineTuningOptions(), pgo, &callbacks);
+    passBuilder.registerModuleAnalyses(mam);
+    passBuilder.registerCGSCCAnalyses(cgam);
+    passBuilder.registerFunctionAnalyses(fam);
+    passBuilder.registerLoopAnalyses(lam);
+    passBuilder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::OptimizationLevel level = toOptimizationLevel(m_options.optLevel);
+    llvm::ModulePassManager mpm;
+    if (m_options.thinLto) {
+        // The ThinLTO pre-link pipeline stops short of what only pays off once
+        // functions from other modules have been imported (full unrolling,
+        // vectorization, ...); the linker runs the rest after importing.
+        mpm = passBuilder.buildThinLTOPreLinkDefaultPipeline(level);
+    } else if (m_options.optLevel == OptLevel::O0) {
+        // Only the passes that are required for correctness (e.g. always-inline),
+        // plus dropping the internal functions nothing calls, which the other
+        // pipelines do as well and which costs next to nothing.
+        mpm = passBuilder.buildO0DefaultPipeline(level);
+        mpm.addPass(llvm::GlobalDCEPass());
+    } else {
+        mpm = passBuilder.buildPerModuleDefaultPipeline(level);
+    }
 
-    if (!target) {
-        llvm::errs() << error;
-        return;
+    mpm.run(module, mam);
+
+    // --time-report: print this pipeline's per-pass table now, before the
+    // instrumentation (and its timers) go away.
+    if (llvm::TimePassesIsEnabled) {
+        std::string table;
+        llvm::raw_string_ostream stream(table);
+        instrumentation.getTimePasses().setOutStream(stream);
+        instrumentation.getTimePasses().print();
+        m_output << stream.str();
     }
+}
 
-    auto CPU = "generic";
-    auto features = "";
-    llvm::TargetOptions opt;
-    auto rm = llvm::Reloc::Model::PIC_;
-    auto targetMachine = target->createTargetMachine(targetTriple, CPU, features, opt, rm);
+size_t CodeGen::functionCount() const {
+    size_t count = 0;
+    for (const llvm::Function& function : *m_module) {
+        if (!function.isDeclaration()) count++;
+    }
+    return count;
+}
 
-    m_module->setDataLayout(targetMachine->createDataLayout());
+size_t CodeGen::instructionCount() const {
+    return m_module->getInstructionCount();
+}
 
+llvm::orc::ThreadSafeModule CodeGen::takeModule() {
+    return llvm::orc::ThreadSafeModule(std::move(m_module), std::move(m_context));
+}
+
+std::vector<std::string> CodeGen::objectFiles(const std::string& filename, const CompileOptions& options) {
+    if (!options.objectFileOverride.empty()) {
+        return options.objectFileOverride;
+    }
+
+    // The first partition keeps the requested name, so build rules that only
+    // know about it still find it: out.o, out.1.o, out.2.o, ...
+    std::vector<std::string> filenames = {filename};
+    std::string extension = outputExtension(options);
+    std::string stem = filename;
+    if (stem.size() > extension.size() &&
+        stem.compare(stem.size() - extension.size(), extension.size(), extension) == 0) {
+        stem.resize(stem.size() - extension.size());
+    }
+    for (unsigned i = 1; i < options.partitions(); i++) {
+        filenames.push_back(stem + "." + std::to_string(i) + extension);
+    }
+    return filenames;
+}
+
+bool CodeGen::emitObjectFile(const std::string& filename) {
+    if (!m_target_machine) {
+        return false; // Error was already printed by createTargetMachine
+    }
+
+    std::vector<std::string> filenames = objectFiles(filename, m_options);
+    if (filenames.size() > 1) {
+        return emitPartitions(filenames);
+    }
+    return emitModule(*m_module, filenames[0]);
+}
+
+// -S asks for assembly instead of an object file.
+static llvm::CodeGenFileType fileType(const CompileOptions& options) {
+    return options.emitAssembly ? llvm::CodeGenFileType::AssemblyFile : llvm::CodeGenFileType::ObjectFile;
+}
+
+// Writes `module` as bitcode together with its module summary: the functions,
+// their call graph edges and the globals they reference. The linker's thin
+// link reads only the summaries to decide what to import where, including
+// functions from C and C++ modules compiled with clang -flto=thin.
+static void writeThinLtoBitcode(llvm::Module& module, llvm::raw_ostream& stream) {
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+    llvm::PassBuilder passBuilder;
+    passBuilder.registerModuleAnalyses(mam);
+    passBuilder.registerCGSCCAnalyses(cgam);
+    passBuilder.registerFunctionAnalyses(fam);
+    passBuilder.registerLoopAnalyses(lam);
+    passBuilder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::ModulePassManager mpm;
+    mpm.addPass(llvm::ThinLTOBitcodeWriterPass(stream, /*ThinLinkOS=*/nullptr));
+    mpm.run(module, mam);
+}
+
+bool CodeGen::emitModule(llvm::Module& module, const std::string& filename) {
     std::error_code ec;
     llvm::raw_fd_ostream dest(filename, ec, llvm::sys::fs::OF_None);
     if (ec) {
-        llvm::errs() << "Could not open file: " << ec.message();
-        return;
+        m_diagnostics << "CodeGen Error: Could not open file '" << filename << "': " << ec.message() << "\n";
+        return false;
+    }
+
+    // LLVM IR instead of machine code: as text, as bitcode, or as bitcode
+    // with the summary ThinLTO's thin link works from.
+    if (m_options.writesIr()) {
+        if (m_options.emitAssembly) {
+            module.print(dest, nullptr);
+        } else if (m_options.thinLto) {
+            writeThinLtoBitcode(module, dest);
+        } else {
+            llvm::WriteBitcodeToFile(module, dest);
+        }
+        dest.flush();
+        return true;
     }
 
     llvm::legacy::PassManager pass;
-    if (targetMachine->addPassesToEmitFile(pass, dest, nullptr, llvm::CodeGenFileType::ObjectFile)) {
-        llvm::errs() << "The TargetMachine can't emit a file of this type.";
-        return;
+    if (m_target_machine->addPassesToEmitFile(pass, dest, nullptr, fileType(m_options))) {
+        m_diagnostics << "CodeGen Error: The TargetMachine can't emit a file of this type.\n";
+        return false;
     }
 
-    pass.run(*m_module);
+    pass.run(module);
     dest.flush();
-    std::cout << "Successfully wrote object file to '" << filename << "'\n";
+    return true;
+}
+
+std::string CodeGen::localSymbolSuffix(const CompileOptions& options) {
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::weakly_canonical(std::filesystem::absolute(options.inputs[0], ec), ec);
+    std::string text = ec ? options.inputs[0] : path.string();
+    return ".local." + llvm::utohexstr(llvm::xxHash64(text));
+}
+
+bool CodeGen::emitPartition(const std::unordered_set<std::string>& functions, const std::string& filename) {
+    if (!m_target_machine) {
+        return false; // Error was already printed by createTargetMachine
+    }
+
+    // 1. Copy the module with every other function turned into a declaration.
+    //    Global variables (the string literals) are all copied...
+    llvm::ValueToValueMapTy valueMap;
+    std::unique_ptr<llvm::Module> partition =
+        llvm::CloneModule(*m_module, valueMap, [&](const llvm::GlobalValue* value) {
+            return !llvm::isa<llvm::Function>(value) || functions.count(std::string(value->getName())) > 0;
+        });
+
+    // 2. ...and the ones no function of this partition uses are dropped again,
+    //    so they don't end up in every object file.
+    for (auto it = partition->global_begin(); it != partition->global_end();) {
+        llvm::GlobalVariable& global = *it++;
+        global.removeDeadConstantUsers();
+        if (global.use_empty() && global.hasLocalLinkage()) {
+            global.eraseFromParent();
+        }
+    }
+
+    // 3. Internal functions may be called from other partitions, so they are
+    //    made hidden instead: visible to the other object files of the
+    //    program but not outside it. The name gets a suffix unique to the
+    //    input, so two inputs can still have internal functions of the same
+    //    name. (Nothing is dropped for being unused either: a partition that
+    //    is reused can't know whether the one with the caller changed.)
+    std::string suffix = localSymbolSuffix(m_options);
+    for (llvm::Function& original : *m_module) {
+        if (!original.hasLocalLinkage()) continue;
+        // Copies and declarations alike; CloneModule made the declarations external already.
+        auto* function = llvm::cast<llvm::Function>(static_cast<llvm::Value*>(valueMap[&original]));
+        function->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        function->setVisibility(llvm::GlobalValue::HiddenVisibility);
+        function->setName(original.getName() + suffix);
+    }
+
+    // 4. Optimize and emit the partition on its own.
+    optimizeModule(*partition);
+    if (m_llvm_error) {
+        return false;
+    }
+    return emitModule(*partition, filename);
+}
+
+// --- Parallel Code Generation ---
+// Instruction selection and register allocation work on one function at a
+// time, so the backend parallelizes well once the module is cut into pieces.
+// llvm::splitCodeGen partitions the (already optimized) module by call graph
+// locality, clones each partition into its own LLVMContext and runs a
+// separate TargetMachine over each one on its own thread. Functions that are
+// called across partitions are made visible to the linker, which is what
+// joins the objects back together.
+bool CodeGen::emitPartitions(const std::vector<std::string>& filenames) {
+    // Module-local globals (the string literals and the functions that
+    // aren't exported) that are used across partitions become hidden symbols
+    // under their own names, which other inputs may use as well. Renaming
+    // them first keeps two inputs linkable.
+    std::string suffix = localSymbolSuffix(m_options);
+    for (llvm::GlobalValue& value : m_module->global_values()) {
+        if (value.hasLocalLinkage()) {
+            value.setName(value.getName() + suffix);
+        }
+    }
+
+    std::vector<std::unique_ptr<llvm::raw_fd_ostream>> files;
+    std::vector<llvm::raw_pwrite_stream*> streams;
+    for (const std::string& filename : filenames) {
+        std::error_code ec;
+        files.push_back(std::make_unique<llvm::raw_fd_ostream>(filename, ec, llvm::sys::fs::OF_None));
+        if (ec) {
+            m_diagnostics << "CodeGen Error: Could not open file '" << filename << "': " << ec.message() << "\n";
+            return false;
+        }
+        streams.push_back(files.back().get());
+    }
+
+    // Each thread needs a TargetMachine of its own, configured like ours.
+    const llvm::Target& target = m_target_machine->getTarget();
+    std::string triple = m_target_machine->getTargetTriple().str();
+    llvm::TargetOptions targetOptions = m_target_machine->Options;
+    auto createTargetMachine = [&]() {
+        return std::unique_ptr<llvm::TargetMachine>(target.createTargetMachine(
+            triple, m_cpu, m_features, targetOptions, llvm::Reloc::Model::PIC_, std::nullopt,
+            toCodeGenOptLevel(m_options.optLevel)));
+    };
+
+    llvm::splitCodeGen(*m_module, streams, /*BCOSs=*/{}, createTargetMachine, fileType(m_options));
+
+    for (auto& file : files) {
+        file->close();
+        if (file->has_error()) {
+            m_diagnostics << "CodeGen Error: Could not write object file: " << file->error().message() << "\n";
+            file->clear_error();
+            return false;
+        }
+    }
+    return true;
 }
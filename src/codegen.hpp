@@ -1,45 +1,153 @@
 #pragma once
 #include "ast.hpp"
+#include "options.hpp"
+#include "scope.hpp"
+#include "ssa.hpp"
 #include <memory>
-#include <map> // <-- NEW: For our symbol table
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Value.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 
-class CodeGen : public AstVisitor {
+// Turns the -mcpu/-mattr options into the CPU name and feature string the
+// TargetMachine wants. "native" becomes the host CPU plus every feature the host reports.
+void resolveTargetCpu(const CompileOptions& options, std::string& cpu, std::string& features);
+
+class CodeGen {
 public:
-    CodeGen();
-    void generate(ProgramNode* program);
-    void dump();
-    void emitObjectFile(const std::string& filename);
+    // Reports (like --time-report's pass table) go to `output`, errors and
+    // IR dumps to `diagnostics`.
+    CodeGen(const CompileOptions& options, std::ostream& output, std::ostream& diagnostics);
+    ~CodeGen(); // Hands the TargetMachine on to the next CodeGen for the same target
+
+    // Generates IR for every function in the tree. A function with an error
+    // is left as a declaration, and the rest are still checked so that every
+    // error gets reported. Returns false if there were any.
+    bool generate(const Ast& ast);
+    void dump(); // Prints the module to the diagnostics stream
+
+    // Runs LLVM's optimization pipeline for the requested -O level over the
+    // module (instrumenting it or applying a profile, if asked to). Returns
+    // false if LLVM reported an error, e.g. an unreadable profile.
+    bool optimize();
+
+    // Writes the module as machine code to objectFiles(filename, options):
+    // one file, or with --codegen-threads=N, N files generated in parallel.
+    bool emitObjectFile(const std::string& filename);
+    static std::vector<std::string> objectFiles(const std::string& filename, const CompileOptions& options);
+
+    // For --incremental (see incremental.hpp): optimizes and writes only the
+    // named functions to `filename`, calling every other one as an external.
+    bool emitPartition(const std::unordered_set<std::string>& functions, const std::string& filename);
+
+    // What the names of module-local symbols get appended when they are made
+    // visible to the other object files of the same input: ".local." and a
+    // hash of the input's absolute path, so that no two inputs linked
+    // together pick the same names however they were spelled.
+    static std::string localSymbolSuffix(const CompileOptions& options);
+
+    // Hands the module, together with the context that owns it, over to the
+    // JIT. The CodeGen object must not be used to generate code afterwards.
+    llvm::orc::ThreadSafeModule takeModule();
+
+    // Sizes of the module, for --time-report. Both walk the whole module.
+    size_t functionCount() const;    // Functions with a body (not declarations like printf)
+    size_t instructionCount() const;
+
+    // The CPU and features the module was generated for.
+    const std::string& cpu() const { return m_cpu; }
+    const std::string& features() const { return m_features; }
 
 private:
-    // Visitor Methods for all our AST nodes
-    void visit(ProgramNode* node) override;
-    void visit(FunctionDefinitionNode* node) override;
-    void visit(FunctionCallStatementNode* node) override;
-    void visit(StringLiteralNode* node) override;
-    void visit(NumberLiteralNode* node) override; // <-- NEW
-    void visit(BinaryOpNode* node) override;      // <-- NEW
-    void visit(VariableNode* node) override;      // <-- NEW
-    void visit(ReturnStatementNode* node) override;
-    void visit(AutoStatementNode* node) override;
-    void visit(FunctionCallExpressionNode* node) override;
+    // Where reports and errors go (see the constructor)
+    std::ostream& m_output;
+    std::ostream& m_diagnostics;
+
+    // The tree currently being generated (only valid inside generate())
+    const Ast* m_ast = nullptr;
 
     // --- Core LLVM Objects ---
     std::unique_ptr<llvm::LLVMContext> m_context;
     std::unique_ptr<llvm::Module> m_module;
-    std::unique_ptr<llvm::IRBuilder<>> m_builder;
 
-    // --- NEW: Symbol Table ---
-    // Maps a variable name (string) to its memory location (Value*).
-    std::map<std::string, llvm::Value*> m_symbol_table;
+    // --- Target ---
+    // Created up front so the module gets the right triple and data layout
+    // before any IR is generated, and so the optimizer sees the real target.
+    CompileOptions m_options;
+    std::unique_ptr<llvm::TargetMachine> m_target_machine;
+    std::string m_cpu;      // The resolved CPU name ("native" already replaced)
+    std::string m_features; // The resolved feature string
+    std::string m_target_key; // Identifies the TargetMachine's settings in the pool
+
+    // --- Symbol Tables ---
+    // Maps a function's Symbol to the llvm::Function we created for it.
+    ScopedSymbolTable<llvm::Function*> m_function_table;
 
-    // Helper member for passing values from expressions
-    llvm::Value* m_last_value = nullptr;
+    // --- Lowering ---
+    // Variables live in SSA values, not in memory: the symbol table maps a
+    // variable's Symbol to its declaration, and the SsaBuilder knows the
+    // value it holds at any point. Each function body is a scope.
+    struct LocalVariable {
+        SsaVariable id;
+        llvm::Type* type;
+    };
+
+    // Everything that changes while one function is lowered. It is passed
+    // along explicitly rather than kept in the CodeGen, and start() resets it
+    // for the next function (keeping its tables' memory, which is why it is
+    // reused at all), so nothing carries over from one function to another.
+    struct FunctionState {
+        explicit FunctionState(llvm::LLVMContext& context) : builder(context) {}
+        void start(llvm::Function* function);
+
+        llvm::Function* function = nullptr;
+        llvm::IRBuilder<> builder;
+        ScopedSymbolTable<LocalVariable> variables;
+        SsaBuilder ssa;
+        SsaVariable nextVariable = 0;
+        const Token* returned = nullptr; // The 'return' that ended the body, once there is one
+    };
+
+    // Each returns false, or nullptr, after printing the error; the caller
+    // gives up on the function. Expressions return their value.
+    bool lowerFunction(FunctionState& state, const FunctionDefinitionNode& node);
+    bool lowerStatement(FunctionState& state, NodeIndex index);
+    bool lowerPrint(FunctionState& state, const FunctionCallNode& call);
+    llvm::Value* lowerExpression(FunctionState& state, NodeIndex index);
+    llvm::Value* lowerCall(FunctionState& state, const FunctionCallNode& call);
+
+    // Declares a new variable in the innermost scope, holding `value` from here on.
+    void declareVariable(FunctionState& state, const Token& name, llvm::Value* value);
+
+    // Set when LLVM reports an error through the context (see handleLlvmDiagnostic)
+    bool m_llvm_error = false;
+    static void handleLlvmDiagnostic(const llvm::DiagnosticInfo& info, void* context);
 
     // Helper to get LLVM type from our type names
     llvm::Type* getLlvmType(const Token& token);
+
+    // The text of a token, looked up in the source the Ast was parsed from.
+    std::string_view text(const Token& token) const { return m_ast->text(token); }
+
+    // Starts a diagnostic that points at `token`.
+    std::ostream& errorAt(const Token& token);
+
+    // Looks up the host target and builds the TargetMachine for it, or reuses
+    // one from an earlier CodeGen.
+    void createTargetMachine();
+    static void returnTargetMachine(std::unique_ptr<llvm::TargetMachine> targetMachine, const std::string& key);
+
+    // Splits the module into one partition per file and emits them on as many threads.
+    bool emitPartitions(const std::vector<std::string>& filenames);
+
+    // The -O pipeline and the backend, for the whole module or one partition of it.
+    void optimizeModule(llvm::Module& module);
+    bool emitModule(llvm::Module& module, const std::string& filename);
 };
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include "consteval.hpp"
+#include <charconv>
+#include <climits>
+
+ConstexprInterpreter::ConstexprInterpreter(const Ast& ast, std::ostream& diagnostics, ConstexprLimits limits)
+    : m_ast(ast), m_diagnostics(diagnostics), m_limits(limits) {}
+
+// --- Definitions ---
+
+bool ConstexprInterpreter::define(NodeIndex index) {
+    FunctionDefinitionNode function = m_ast.function(index);
+    Symbol name = function.functionName.symbol;
+    bool valid = true;
+    if (function.returnType.symbol != sym::Int32) {
+        error(function.returnType, "constexpr function '" + std::string(m_ast.text(function.functionName)) + "' must return int32_t");
+        valid = false;
+    }
+
+    // Defined before its body is checked, so that it may call itself.
+    m_functions[name] = index;
+    for (NodeIndex statement : function.body) {
+        valid = check(function, statement) && valid;
+    }
+    if (!valid) {
+        m_functions.erase(name);
+    }
+    return valid;
+}
+
+bool ConstexprInterpreter::check(const FunctionDefinitionNode& function, NodeIndex index) {
+    std::string functionName(m_ast.text(function.functionName));
+    switch (m_ast.kind(index)) {
+        case NodeKind::FunctionCallStatement:
+        case NodeKind::FunctionCallExpression: {
+            FunctionCallNode call = m_ast.call(index);
+            bool valid = true;
+            if (call.functionName.symbol == sym::Print) {
+                error(call.functionName, "constexpr function '" + functionName + "' can't print");
+                return false; // Whatever it prints
+            }
+            if (!isDefined(call.functionName.symbol)) {
+                error(call.functionName, "constexpr function '" + functionName + "' can only call constexpr functions defined before it, and '" +
+                                         std::string(m_ast.text(call.functionName)) + "' isn't one");
+                valid = false;
+            }
+            for (NodeIndex argument : call.arguments) valid = check(function, argument) && valid;
+            return valid;
+        }
+        case NodeKind::ReturnStatement:
+            return check(function, m_ast.returnStatement(index).returnValue);
+        case NodeKind::AutoStatement:
+            return check(function, m_ast.autoStatement(index).initializer);
+        case NodeKind::AssignmentStatement:
+            return check(function, m_ast.assignment(index).value);
+        case NodeKind::BinaryOp: {
+            bool left = check(function, m_ast.binaryOp(index).left);
+            return check(function, m_ast.binaryOp(index).right) && left;
+        }
+        case NodeKind::ShiftLeft:
+        case NodeKind::DivideByPowerOfTwo:
+            return check(function, m_ast.shift(index).operand);
+        case NodeKind::StringLiteral:
+            error(m_ast.leafToken(index), "constexpr function '" + functionName + "' can only compute with int32_t");
+            return false;
+        default:
+            return true; // Numbers and variables
+    }
+}
+
+// --- Evaluation ---
+// Calls nest as deep as -fconstexpr-depth allows, far deeper than the stack
+// of the thread compiling (a -j worker, a server thread) could recurse. So
+// nothing here recurses: the work still to do is kept on m_tasks, innermost
+// last, and the values computed so far on m_values.
+
+std::optional<int32_t> ConstexprInterpreter::call(const Token& callSite, const std::vector<int32_t>& arguments) {
+    auto it = m_functions.find(callSite.symbol);
+    if (it == m_functions.end()) return std::nullopt;
+
+    m_call_site = &callSite;
+    m_tasks.clear();
+    m_values.assign(arguments.begin(), arguments.end());
+    m_locals.clear();
+    m_frame = 0;
+    m_steps = 0;
+    m_depth = 0;
+
+    m_tasks.push_back({Task::Invoke, it->second, arguments.size()});
+    while (!m_tasks.empty()) {
+        Task task = m_tasks.back();
+        m_tasks.pop_back();
+        if (!run(task)) return std::nullopt;
+    }
+    return m_values.back();
+}
+
+bool ConstexprInterpreter::run(const Task& task) {
+    switch (task.kind) {
+        case Task::Evaluate:
+            return evaluate(task.node);
+
+        case Task::Invoke:
+            return invoke(task.node, task.extra);
+
+        case Task::Statement:
+            return runStatement(task.node, static_cast<uint32_t>(task.extra));
+
+        case Task::Leave:
+            m_depth--;
+            m_locals.resize(m_frame);
+            m_frame = task.extra;
+            return true;
+
+        case Task::Combine: {
+            BinaryOpNode node = m_ast.binaryOp(task.node);
+            int32_t right = pop(), left = pop();
+            // Unsigned, so that it wraps around like the generated code does.
+            uint32_t a = static_cast<uint32_t>(left), b = static_cast<uint32_t>(right);
+            switch (node.op.type) {
+                case TokenType::PLUS: m_values.push_back(static_cast<int32_t>(a + b)); return true;
+                case TokenType::MINUS: m_values.push_back(static_cast<int32_t>(a - b)); return true;
+                case TokenType::STAR: m_values.push_back(static_cast<int32_t>(a * b)); return true;
+                case TokenType::SLASH: {
+                    std::optional<int32_t> quotient = divide(node.op, left, right);
+                    if (!quotient) return false;
+                    m_values.push_back(*quotient);
+                    return true;
+                }
+                default: return false;
+            }
+        }
+
+        case Task::Shift: {
+            ShiftNode node = m_ast.shift(task.node);
+            int32_t operand = pop();
+            m_values.push_back(m_ast.kind(task.node) == NodeKind::ShiftLeft
+                                   ? static_cast<int32_t>(static_cast<uint32_t>(operand) << node.amount)
+                                   : operand / (int32_t{1} << node.amount));
+            return true;
+        }
+
+        case Task::Declare:
+            m_locals.push_back({m_ast.autoStatement(task.node).name.symbol, pop()});
+            return true;
+
+        case Task::Assign: {
+            int32_t* variable = lookup(m_ast.assignment(task.node).name.symbol);
+            if (!variable) return false;
+            *variable = pop();
+            return true;
+        }
+
+        case Task::Discard:
+            pop();
+            return true;
+    }
+    return false;
+}
+
+bool ConstexprInterpreter::invoke(NodeIndex index, size_t argumentCount) {
+    FunctionDefinitionNode function = m_ast.function(index);
+    if (argumentCount != function.parameters.size()) {
+        return false; // The code generator reports the call
+    }
+    if (m_depth == m_limits.depth) {
+        error(*m_call_site, "Evaluating '" + std::string(m_ast.text(*m_call_site)) + "' at compile time nests calls more than " +
+                            std::to_string(m_limits.depth) + " deep (see -fconstexpr-depth)");
+        return false;
+    }
+
+    // 1. A new frame with the arguments, the last values computed, in it...
+    size_t first = m_values.size() - argumentCount;
+    m_tasks.push_back({Task::Leave, index, m_frame});
+    m_frame = m_locals.size();
+    for (size_t i = 0; i < argumentCount; i++) {
+        m_locals.push_back({m_ast.parameter(function.parameters[i]).name.symbol, m_values[first + i]});
+    }
+    m_values.resize(first);
+
+    // 2. ...that Leave drops once the body returns, with the result on m_values.
+    m_depth++;
+    m_tasks.push_back({Task::Statement, index, 0});
+    return true;
+}
+
+bool ConstexprInterpreter::runStatement(NodeIndex index, uint32_t position) {
+    NodeList body = m_ast.function(index).body;
+    if (position == body.size()) {
+        return false; // No return: the code generator reports it
+    }
+    if (!step()) return false;
+
+    // A return leaves out the statements after it, so that the Leave of the
+    // call comes next.
+    NodeIndex statement = body[position];
+    switch (m_ast.kind(statement)) {
+        case NodeKind::FunctionCallStatement:
+            m_tasks.push_back({Task::Statement, index, position + 1});
+            m_tasks.push_back({Task::Discard, statement, 0});
+            return pushCall(statement);
+        case NodeKind::ReturnStatement:
+            m_tasks.push_back({Task::Evaluate, m_ast.returnStatement(statement).returnValue, 0});
+            return true;
+        case NodeKind::AutoStatement:
+            m_tasks.push_back({Task::Statement, index, position + 1});
+            m_tasks.push_back({Task::Declare, statement, 0});
+            m_tasks.push_back({Task::Evaluate, m_ast.autoStatement(statement).initializer, 0});
+            return true;
+        case NodeKind::AssignmentStatement:
+            m_tasks.push_back({Task::Statement, index, position + 1});
+            m_tasks.push_back({Task::Assign, statement, 0});
+            m_tasks.push_back({Task::Evaluate, m_ast.assignment(statement).value, 0});
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ConstexprInterpreter::evaluate(NodeIndex index) {
+    if (!step()) return false;
+    switch (m_ast.kind(index)) {
+        case NodeKind::Constant:
+            m_values.push_back(m_ast.constant(index));
+            return true;
+
+        case NodeKind::NumberLiteral: {
+            // Only seen in a function that calls itself, before the simplifier
+            // got to the literal. One that doesn't fit is reported by CodeGen.
+            std::string_view digits = m_ast.text(m_ast.leafToken(index));
+            int32_t value = 0;
+            auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            if (ec != std::errc() || end != digits.data() + digits.size()) return false;
+            m_values.push_back(value);
+            return true;
+        }
+
+        case NodeKind::Variable: {
+            int32_t* variable = lookup(m_ast.leafToken(index).symbol);
+            if (!variable) return false;
+            m_values.push_back(*variable);
+            return true;
+        }
+
+        case NodeKind::FunctionCallExpression:
+            return pushCall(index);
+
+        case NodeKind::BinaryOp: // Left operand first: it ends up on top
+            m_tasks.push_back({Task::Combine, index, 0});
+            m_tasks.push_back({Task::Evaluate, m_ast.binaryOp(index).right, 0});
+            m_tasks.push_back({Task::Evaluate, m_ast.binaryOp(index).left, 0});
+            return true;
+
+        case NodeKind::ShiftLeft:
+        case NodeKind::DivideByPowerOfTwo:
+            m_tasks.push_back({Task::Shift, index, 0});
+            m_tasks.push_back({Task::Evaluate, m_ast.shift(index).operand, 0});
+            return true;
+
+        default:
+            return false; // String literals, which define() rejects
+    }
+}
+
+bool ConstexprInterpreter::pushCall(NodeIndex index) {
+    FunctionCallNode call = m_ast.call(index);
+    auto it = m_functions.find(call.functionName.symbol);
+    if (it == m_functions.end()) return false;
+
+    // The arguments in order, then the call that takes them off m_values.
+    m_tasks.push_back({Task::Invoke, it->second, call.arguments.size()});
+    for (size_t i = call.arguments.size(); i > 0; i--) {
+        m_tasks.push_back({Task::Evaluate, call.arguments[i - 1], 0});
+    }
+    return true;
+}
+
+int32_t ConstexprInterpreter::pop() {
+    int32_t value = m_values.back();
+    m_values.pop_back();
+    return value;
+}
+
+std::optional<int32_t> ConstexprInterpreter::divide(const Token& op, int32_t left, int32_t right) {
+    const char* problem = right == 0 ? "Division by zero"
+                        : right == -1 && left == INT32_MIN ? "Division overflows int32_t"
+                        : nullptr;
+    if (problem) {
+        error(op, std::string(problem) + " while evaluating '" + std::string(m_ast.text(*m_call_site)) + "' at compile time (called at " +
+                  std::to_string(m_call_site->line) + ":" + std::to_string(m_call_site->column) + ")");
+        return std::nullopt;
+    }
+    return left / right;
+}
+
+int32_t* ConstexprInterpreter::lookup(Symbol name) {
+    // Innermost declaration first, and only within the current call.
+    for (size_t i = m_locals.size(); i > m_frame; i--) {
+        if (m_locals[i - 1].first == name) return &m_locals[i - 1].second;
+    }
+    return nullptr;
+}
+
+bool ConstexprInterpreter::step() {
+    if (++m_steps > m_limits.steps) {
+        error(*m_call_site, "Evaluating '" + std::string(m_ast.text(*m_call_site)) + "' at compile time takes more than " +
+                            std::to_string(m_limits.steps) + " steps (see -fconstexpr-steps)");
+        return false;
+    }
+    return true;
+}
+
+void ConstexprInterpreter::error(const Token& token, const std::string& message) {
+    m_diagnostics << "Error at " << token.line << ":" << token.column << ": " << message << "\n";
+    m_ok = false;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "ast.hpp"
+#include "interner.hpp"
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// --- Compile-Time Evaluation ---
+// `constexpr int32_t f(...) { ... }` declares a function the compiler may run
+// itself. The simplifier (see simplify.hpp) hands every call to one whose
+// arguments are all constants to this interpreter, which walks the callee's
+// tree, and the call is replaced by the result. The function is still
+// compiled as usual, for the calls whose arguments aren't constant.
+//
+// The rules are checked where the function is defined: it returns int32_t,
+// computes only with int32_t (no string literals), doesn't print, and only
+// calls constexpr functions defined before it (or itself).
+//
+// The language has no branches, so a function that calls itself never
+// returns, and one that calls another twice at every level takes exponential
+// time. Evaluation is bounded like in C++ compilers: by how deep calls nest
+// (-fconstexpr-depth) and by how many expressions and statements one call
+// site may evaluate (-fconstexpr-steps). Hitting a limit is an error, as are
+// division by zero and INT32_MIN / -1, which have no value at run time either.
+struct ConstexprLimits {
+    uint32_t steps = 1048576;
+    uint32_t depth = 512;
+};
+
+class ConstexprInterpreter {
+public:
+    ConstexprInterpreter(const Ast& ast, std::ostream& diagnostics, ConstexprLimits limits);
+
+    // Checks the rules above for a constexpr function and, if it keeps to
+    // them, makes it callable. Returns false after printing what's wrong.
+    bool define(NodeIndex function);
+    bool isDefined(Symbol name) const { return m_functions.count(name) != 0; }
+
+    // Evaluates the call at `callSite`. Returns nothing if an error was
+    // printed, or if the callee is broken in a way the code generator reports
+    // (a missing return, an unknown variable, the wrong number of arguments).
+    std::optional<int32_t> call(const Token& callSite, const std::vector<int32_t>& arguments);
+
+    // False once any error has been printed.
+    bool ok() const { return m_ok; }
+
+private:
+    bool check(const FunctionDefinitionNode& function, NodeIndex index);
+
+    // One piece of the evaluation still to do (see call()). `node` is the
+    // expression, statement or function it is about.
+    struct Task {
+        enum Kind : uint8_t {
+            Evaluate,  // Push the value of an expression
+            Invoke,    // Call a function with the last `extra` values as arguments
+            Statement, // Run the statements of a function from number `extra` on
+            Leave,     // Drop the innermost call's frame; `extra` is the caller's
+            Combine,   // Replace the last two values by the BinaryOp of them
+            Shift,     // Replace the last value by the ShiftLeft/DivideByPowerOfTwo of it
+            Declare,   // Take the last value as the AutoStatement's variable
+            Assign,    // Take the last value as the AssignmentStatement's
+            Discard,   // Drop the last value, which a call statement returned
+        } kind;
+        NodeIndex node;
+        size_t extra;
+    };
+
+    // Each returns false once the evaluation can't go on.
+    bool run(const Task& task);
+    bool invoke(NodeIndex function, size_t argumentCount);
+    bool runStatement(NodeIndex function, uint32_t position);
+    bool evaluate(NodeIndex expression);
+    bool pushCall(NodeIndex call);
+
+    std::optional<int32_t> divide(const Token& op, int32_t left, int32_t right);
+    int32_t* lookup(Symbol name);
+    int32_t pop();
+
+    // Counts one step of the evaluation; false once the limit is passed.
+    bool step();
+
+    void error(const Token& token, const std::string& message);
+
+    const Ast& m_ast;
+    std::ostream& m_diagnostics;
+    ConstexprLimits m_limits;
+    bool m_ok = true;
+
+    std::unordered_map<Symbol, NodeIndex> m_functions; // The constexpr functions defined so far
+
+    // --- The evaluation in progress ---
+    const Token* m_call_site = nullptr; // Where the compile-time call is written
+    std::vector<Task> m_tasks;    // What is left to do, next last
+    std::vector<int32_t> m_values; // The values computed but not used yet
+    std::vector<std::pair<Symbol, int32_t>> m_locals; // The variables of every call, innermost last
+    size_t m_frame = 0;    // Where the innermost call's variables start in m_locals
+    uint32_t m_steps = 0;
+    uint32_t m_depth = 0;
+};
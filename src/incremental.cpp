@@ -0,0 +1,213 @@
+#include "incremental.hpp"
+#include "cache.hpp"
+#include "codegen.hpp"
+#include "simplify.hpp"
+#include <unordered_map>
+#include <unordered_set>
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/SHA256.h"
+
+namespace {
+
+// Adds the names of the functions the subtree at `index` calls to `callees`.
+void collectCallees(const Ast& ast, NodeIndex index, std::vector<Symbol>& callees) {
+    switch (ast.kind(index)) {
+        case NodeKind::FunctionCallStatement:
+        case NodeKind::FunctionCallExpression: {
+            FunctionCallNode call = ast.call(index);
+            callees.push_back(call.functionName.symbol);
+            for (NodeIndex argument : call.arguments) collectCallees(ast, argument, callees);
+            break;
+        }
+        case NodeKind::ReturnStatement:
+            collectCallees(ast, ast.returnStatement(index).returnValue, callees);
+            break;
+        case NodeKind::AutoStatement:
+            collectCallees(ast, ast.autoStatement(index).initializer, callees);
+            break;
+        case NodeKind::AssignmentStatement:
+            collectCallees(ast, ast.assignment(index).value, callees);
+            break;
+        case NodeKind::BinaryOp:
+            collectCallees(ast, ast.binaryOp(index).left, callees);
+            collectCallees(ast, ast.binaryOp(index).right, callees);
+            break;
+        case NodeKind::ShiftLeft:
+        case NodeKind::DivideByPowerOfTwo:
+            collectCallees(ast, ast.shift(index).operand, callees);
+            break;
+        default:
+            break; // Literals and variables call nothing
+    }
+}
+
+// Everything a call site needs to know about the function it calls:
+// "export int32_t name(int32_t,int32_t)". Whether it is exported decides
+// the calling convention.
+std::string signature(const Ast& ast, const FunctionDefinitionNode& function) {
+    std::string text = std::string(function.isConstexpr() ? "constexpr " : "") + std::string(function.isExported() ? "export " : "") +
+                       std::string(ast.text(function.returnType)) + " " + std::string(ast.text(function.functionName)) + "(";
+    for (uint32_t i = 0; i < function.parameters.size(); i++) {
+        if (i > 0) text += ",";
+        text += ast.text(ast.parameter(function.parameters[i]).type);
+    }
+    return text + ")";
+}
+
+// Which chunk a function goes into. FNV-1a of the name: stable across runs,
+// platforms and edits to any other function.
+unsigned chunkOf(const std::string& name, unsigned chunkCount) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x100000001b3ull;
+    }
+    return static_cast<unsigned>(hash % chunkCount);
+}
+
+} // namespace
+
+std::vector<FunctionFingerprint> fingerprintFunctions(const Ast& ast) {
+    NodeList functions = ast.program(ast.root()).functions;
+
+    // 1. The text and signature of every function. A function's text runs
+    //    from its return type up to the next function's. Whitespace and
+    //    comments in between are included; there is no debug info, so moving
+    //    a function around doesn't change its code. The qualifiers written
+    //    before the return type end up in the previous function's text, so
+    //    each function also hashes its own signature, which has them.
+    std::string_view source = ast.source();
+    std::vector<std::string_view> texts;
+    std::vector<std::string> signatures;
+    std::unordered_map<Symbol, uint32_t> indexOf;
+    for (uint32_t i = 0; i < functions.size(); i++) {
+        FunctionDefinitionNode function = ast.function(functions[i]);
+        size_t begin = function.returnType.offset;
+        size_t end = i + 1 < functions.size() ? ast.function(functions[i + 1]).returnType.offset : source.size();
+        texts.push_back(source.substr(begin, end - begin));
+        signatures.push_back(signature(ast, function));
+        indexOf.emplace(function.functionName.symbol, i);
+    }
+
+    std::vector<FunctionFingerprint> fingerprints;
+    for (uint32_t i = 0; i < functions.size(); i++) {
+        FunctionDefinitionNode function = ast.function(functions[i]);
+        llvm::SHA256 hasher;
+        hasher.update(signatures[i]);
+        hasher.update(llvm::StringRef("\0", 1));
+        hasher.update(llvm::StringRef(texts[i].data(), texts[i].size()));
+
+        // 2. The code for a call depends on the callee's signature, but not on
+        //    its body, unless the callee is constexpr: then the call may have
+        //    been replaced by its result, which depends on the callee's body
+        //    and on everything that calls in turn.
+        std::vector<Symbol> callees;
+        for (NodeIndex statement : function.body) collectCallees(ast, statement, callees);
+        std::unordered_set<Symbol> seen;
+        for (size_t next = 0; next < callees.size(); next++) { // Grows as constexpr callees are added
+            Symbol callee = callees[next];
+            if (callee == sym::Print || !seen.insert(callee).second) continue;
+            auto it = indexOf.find(callee);
+            hasher.update(llvm::StringRef("\0", 1));
+            if (it == indexOf.end()) {
+                hasher.update("<undefined>");
+                continue;
+            }
+            hasher.update(signatures[it->second]);
+            FunctionDefinitionNode calleeFunction = ast.function(functions[it->second]);
+            if (calleeFunction.isConstexpr()) {
+                hasher.update(llvm::StringRef(texts[it->second].data(), texts[it->second].size()));
+                for (NodeIndex statement : calleeFunction.body) collectCallees(ast, statement, callees);
+            }
+        }
+
+        fingerprints.push_back(FunctionFingerprint{
+            std::string(ast.text(function.functionName)),
+            llvm::toHex(hasher.final(), /*LowerCase=*/true),
+        });
+    }
+    return fingerprints;
+}
+
+bool compileIncrementally(Ast& ast, const CompileOptions& options, TimeReport& report,
+                          std::ostream& out, std::ostream& err) {
+    const std::string& input = options.inputs[0];
+    ObjectCache store(options.incrementalDir, options.cacheSize);
+    std::vector<std::string> objectFiles = CodeGen::objectFiles(options.output, options);
+    unsigned chunkCount = static_cast<unsigned>(objectFiles.size());
+
+    // 1. Sort the functions into chunks and key each chunk by its functions.
+    std::vector<std::vector<FunctionFingerprint>> chunks(chunkCount);
+    for (FunctionFingerprint& fingerprint : fingerprintFunctions(ast)) {
+        chunks[chunkOf(fingerprint.name, chunkCount)].push_back(std::move(fingerprint));
+    }
+
+    // 2. Copy every chunk that is already in the store to its object file.
+    //    A chunk names the internal functions of the others with a suffix
+    //    derived from the input's absolute path (see CodeGen::emitPartition),
+    //    so a chunk compiled from a file at another path must never be
+    //    reused, even when its functions are identical.
+    std::vector<std::string> keys(chunkCount);
+    std::vector<unsigned> changed;
+    std::string localSuffix = CodeGen::localSymbolSuffix(options);
+    {
+        TimeReport::Phase phase(report, "Incremental lookup", input);
+        for (unsigned i = 0; i < chunkCount; i++) {
+            std::string contents = "chunk " + std::to_string(i) + " of " + std::to_string(chunkCount) + "\n";
+            contents += "locals " + localSuffix + "\n";
+            for (const FunctionFingerprint& fingerprint : chunks[i]) {
+                contents += fingerprint.name + " " + fingerprint.hash + "\n";
+            }
+            keys[i] = store.key(contents, options);
+            if (!store.fetch(keys[i], {objectFiles[i]}, err)) {
+                changed.push_back(i);
+            }
+        }
+    }
+    report.addCounter("Chunks reused", chunkCount - changed.size());
+    if (changed.empty() && !options.dumpIr) {
+        return true;
+    }
+
+    // 3. Generate the whole module: the chunks need each other's declarations,
+    //    and IR generation is cheap next to optimizing and emitting it.
+    {
+        TimeReport::Phase phase(report, "Simplification", input);
+        if (!simplifyAst(ast, err, ConstexprLimits{options.constexprSteps, options.constexprDepth})) {
+            err << "Compilation failed due to simplification errors." << std::endl;
+            return false;
+        }
+    }
+    CodeGen generator(options, out, err);
+    {
+        TimeReport::Phase phase(report, "Code generation", input);
+        if (!generator.generate(ast)) {
+            err << "Compilation failed due to code generation errors." << std::endl;
+            return false;
+        }
+    }
+    if (options.dumpIr) {
+        out << "--- LLVM IR Generation ---" << std::endl;
+        generator.dump();
+    }
+
+    // 4. Optimize and emit only the chunks that changed, and keep them for next time.
+    size_t recompiled = 0;
+    for (unsigned i : changed) {
+        std::unordered_set<std::string> names;
+        for (const FunctionFingerprint& fingerprint : chunks[i]) {
+            names.insert(fingerprint.name);
+        }
+        recompiled += names.size();
+
+        {
+            TimeReport::Phase phase(report, "Optimization + emission", input);
+            if (!generator.emitPartition(names, objectFiles[i])) {
+                return false;
+            }
+        }
+        store.store(keys[i], {objectFiles[i]}, err);
+    }
+    report.addCounter("Functions recompiled", recompiled);
+    return true;
+}
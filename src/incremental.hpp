@@ -0,0 +1,43 @@
+#pragma once
+#include "ast.hpp"
+#include "options.hpp"
+#include "timing.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// --- Incremental Compilation ---
+// --incremental=<dir> compiles each input into --incremental-chunks object
+// files (out.o, out.1.o, ...; all of them must be linked). Every function
+// goes into the chunk picked by a hash of its name, so it stays in the same
+// chunk however the rest of the file changes.
+//
+// A function's fingerprint covers its source text and the signatures of the
+// functions it calls, which is everything its code depends on, except that a
+// call to a constexpr function may be evaluated at compile time: for those,
+// the callee's text (and its callees') is part of the fingerprint too. A chunk is
+// keyed by the fingerprints of its functions plus the compiler and flags (as
+// in the object cache), and compiled chunks are kept in <dir>, which is an
+// ObjectCache. After an edit only the chunks holding a changed function are
+// optimized and emitted again; every other chunk is copied from <dir>.
+//
+// Lexing and parsing still cover the whole file: they are needed to find the
+// functions and take a few percent of the time of optimization and emission.
+// Chunks are optimized on their own, so calls between chunks are not inlined,
+// which is what splitting a program into several source files costs as well.
+
+// One function's identity for the incremental store.
+struct FunctionFingerprint {
+    std::string name;
+    std::string hash; // Hex SHA-256 of its text and its callees' signatures
+};
+
+// The fingerprints of all functions of the program, in definition order.
+// Needs the tree as parsed, before simplifyAst() folds calls away.
+std::vector<FunctionFingerprint> fingerprintFunctions(const Ast& ast);
+
+// Simplifies the parsed program (see simplify.hpp) and compiles it into CodeGen::objectFiles(options.output, options),
+// regenerating only the chunks that changed. Returns false (after printing
+// why to `err`) on failure.
+bool compileIncrementally(Ast& ast, const CompileOptions& options, TimeReport& report,
+                          std::ostream& out, std::ostream& err);
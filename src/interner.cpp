@@ -0,0 +1,55 @@
+#include "interner.hpp"
+#include <cstring>
+
+// Large enough that a typical program needs just a handful of chunks.
+static constexpr size_t kChunkSize = 64 * 1024;
+
+StringInterner::StringInterner() {
+    // Must match the order of the sym:: enum.
+    static const char* const predefined[] = {
+        "", "return", "auto", "constexpr", "export", "static", "int32_t", "print", "main",
+    };
+    static_assert(sizeof(predefined) / sizeof(predefined[0]) == sym::FirstUserSymbol,
+                  "the predefined names and the sym:: enum are out of sync");
+
+    for (const char* text : predefined) {
+        intern(text);
+    }
+}
+
+Symbol StringInterner::intern(std::string_view text) {
+    auto it = m_lookup.find(text);
+    if (it != m_lookup.end()) {
+        return it->second;
+    }
+
+    std::string_view stored = store(text);
+    Symbol symbol = static_cast<Symbol>(m_names.size());
+    m_names.push_back(stored);
+    m_lookup.emplace(stored, symbol);
+    return symbol;
+}
+
+std::string_view StringInterner::name(Symbol symbol) const {
+    return m_names[symbol];
+}
+
+size_t StringInterner::size() const {
+    return m_names.size();
+}
+
+std::string_view StringInterner::store(std::string_view text) {
+    if (text.size() > m_remaining) {
+        // Strings longer than a chunk get a chunk of their own.
+        size_t size = text.size() > kChunkSize ? text.size() : kChunkSize;
+        m_chunks.push_back(std::make_unique<char[]>(size));
+        m_cursor = m_chunks.back().get();
+        m_remaining = size;
+    }
+
+    char* start = m_cursor;
+    if (!text.empty()) std::memcpy(start, text.data(), text.size());
+    m_cursor += text.size();
+    m_remaining -= text.size();
+    return std::string_view(start, text.size());
+}
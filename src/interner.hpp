@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// An interned string. Two identifiers have the same Symbol exactly when they
+// have the same spelling, so comparing names is one integer compare and a
+// Symbol can be used directly as an array index.
+using Symbol = uint32_t;
+
+// Symbol 0 means "not an identifier".
+constexpr Symbol kNoSymbol = 0;
+
+// Names the compiler itself needs to recognize. They are interned first, in
+// this order, so their Symbols are compile-time constants.
+namespace sym {
+enum : Symbol {
+    None = kNoSymbol,
+    // Keywords
+    Return,
+    Auto,
+    Constexpr,
+    Export,
+    Static,
+    // Built-in types and functions
+    Int32,
+    Print,
+    Main,
+
+    FirstUserSymbol
+};
+}
+
+// Maps each distinct string to a small integer and back. The text of every
+// interned string is kept in large chunks owned by the interner, so the
+// string_views it hands out stay valid for the life of the interner.
+//
+// Every compilation has its own (each Lexer owns one), so Symbols stay as
+// small as the number of names in that one file: tables indexed by Symbol
+// (see ScopedSymbolTable) are sized by the file, and a long-running compile
+// server doesn't keep every name it has ever seen. Files compiled in
+// parallel with -j share nothing, so no locking is needed either.
+class StringInterner {
+public:
+    StringInterner();
+
+    // Returns the Symbol for `text`, adding it if this is the first time we see it.
+    Symbol intern(std::string_view text);
+
+    // The spelling of a Symbol.
+    std::string_view name(Symbol symbol) const;
+
+    // The number of Symbols handed out so far (including kNoSymbol).
+    size_t size() const;
+
+private:
+    // Copies `text` into the chunk storage.
+    std::string_view store(std::string_view text);
+
+    std::unordered_map<std::string_view, Symbol> m_lookup;
+    std::vector<std::string_view> m_names;
+
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    char* m_cursor = nullptr;
+    size_t m_remaining = 0;
+};
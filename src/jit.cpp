@@ -0,0 +1,82 @@
+#include "jit.hpp"
+#include <iostream>
+#include <cstdio>
+#include <type_traits>
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/SubtargetFeature.h"
+
+// Matches the -O level the rest of the pipeline used.
+static llvm::CodeGenOptLevel toJitOptLevel(OptLevel level) {
+    return level == OptLevel::O0 ? llvm::CodeGenOptLevel::None : llvm::CodeGenOptLevel::Default;
+}
+
+// The JIT must compile for the same CPU the module was optimized for.
+static llvm::orc::JITTargetMachineBuilder makeTargetMachineBuilder(CodeGen& generator, const CompileOptions& options) {
+    llvm::orc::JITTargetMachineBuilder builder{llvm::Triple(llvm::sys::getProcessTriple())};
+    builder.setCPU(generator.cpu());
+    builder.addFeatures(llvm::SubtargetFeatures(generator.features()).getFeatures());
+    builder.setCodeGenOptLevel(toJitOptLevel(options.optLevel));
+    return builder;
+}
+
+// Both JIT flavours are used the same way once they exist.
+template <typename Jit>
+static int addModuleAndRunMain(Jit& jit, llvm::orc::ThreadSafeModule module) {
+    // Let the program call into the C library (printf for `print`, ...).
+    auto processSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            jit.getDataLayout().getGlobalPrefix());
+    if (!processSymbols) {
+        std::cerr << "JIT Error: " << llvm::toString(processSymbols.takeError()) << "\n";
+        return 1;
+    }
+    jit.getMainJITDylib().addGenerator(std::move(*processSymbols));
+
+    llvm::Error err = llvm::Error::success();
+    if constexpr (std::is_same_v<Jit, llvm::orc::LLLazyJIT>) {
+        err = jit.addLazyIRModule(std::move(module));
+    } else {
+        err = jit.addIRModule(std::move(module));
+    }
+    if (err) {
+        std::cerr << "JIT Error: " << llvm::toString(std::move(err)) << "\n";
+        return 1;
+    }
+
+    auto mainSymbol = jit.lookup("main");
+    if (!mainSymbol) {
+        std::cerr << "JIT Error: " << llvm::toString(mainSymbol.takeError()) << "\n";
+        return 1;
+    }
+
+    auto* mainFunc = mainSymbol->template toPtr<int32_t (*)()>();
+    int32_t result = mainFunc();
+    std::fflush(stdout); // printf output from the program must appear before ours
+    return result;
+}
+
+int runJit(CodeGen& generator, const CompileOptions& options) {
+    auto targetBuilder = makeTargetMachineBuilder(generator, options);
+    llvm::orc::ThreadSafeModule module = generator.takeModule();
+
+    if (options.lazyJit) {
+        // LLLazyJIT splits the module per function and puts a stub in front of
+        // each one; a function's body is only compiled when its stub is first hit.
+        auto jit = llvm::orc::LLLazyJITBuilder().setJITTargetMachineBuilder(std::move(targetBuilder)).create();
+        if (!jit) {
+            std::cerr << "JIT Error: " << llvm::toString(jit.takeError()) << "\n";
+            return 1;
+        }
+        return addModuleAndRunMain(**jit, std::move(module));
+    }
+
+    auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(targetBuilder)).create();
+    if (!jit) {
+        std::cerr << "JIT Error: " << llvm::toString(jit.takeError()) << "\n";
+        return 1;
+    }
+    return addModuleAndRunMain(**jit, std::move(module));
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "codegen.hpp"
+#include "options.hpp"
+
+// Compiles the module held by `generator` in-process with ORC and calls its
+// `main`. Returns main's result as the exit code, or 1 if the JIT failed.
+// With options.lazyJit, functions are only compiled the first time they are called.
+int runJit(CodeGen& generator, const CompileOptions& options);
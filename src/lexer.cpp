@@ -1,31 +1,248 @@
 #include "lexer.hpp"
-#include <cctype> // for isalpha, isalnum, isdigit
+#include <array>
+#include <cstdint>
+#include <cstring>
 
-Lexer::Lexer(const std::string& source) : m_source(source) {}
+// --- Vector Scanning ---
+// The lexer spends almost all of its time walking over runs of whitespace,
+// identifier characters and digits. Those runs are scanned a whole block at a
+// time: each block is classified with a few vector compares, turned into a
+// bitmask with one bit per byte, and the end of the run is the lowest clear
+// bit. AVX2 handles 32 bytes per step and SSE2 16; without either (and for the
+// start of a run and the last few bytes of the buffer) we use a table-driven
+// scalar loop. Blocks are only loaded when they lie entirely inside the buffer,
+// which may be an mmap'ed file with nothing readable past its end.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ATHERIA_LEXER_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define ATHERIA_LEXER_SIMD 1
+#endif
 
-// Helper function to check for keywords
-static TokenType checkKeyword(const std::string& text) {
-    if (text == "return") return TokenType::RETURN;
-    if (text == "auto") return TokenType::AUTO;
-    return TokenType::IDENTIFIER;
+namespace {
+
+// Bit flags for kCharClasses
+enum : uint8_t {
+    kSpace = 1 << 0,      // ' ', '\t', '\r', '\n'
+    kIdentStart = 1 << 1, // [A-Za-z_]
+    kIdentBody = 1 << 2,  // [A-Za-z0-9_]
+    kDigit = 1 << 3,      // [0-9]
+};
+
+// A 256-entry lookup table instead of the <cctype> functions, which go
+// through the C locale on every call.
+constexpr std::array<uint8_t, 256> makeCharClasses() {
+    std::array<uint8_t, 256> classes{};
+    for (int c = 0; c < 256; c++) {
+        bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        bool digit = c >= '0' && c <= '9';
+        uint8_t flags = 0;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') flags |= kSpace;
+        if (alpha) flags |= kIdentStart;
+        if (alpha || digit) flags |= kIdentBody;
+        if (digit) flags |= kDigit;
+        classes[c] = flags;
+    }
+    return classes;
+}
+
+constexpr std::array<uint8_t, 256> kCharClasses = makeCharClasses();
+
+bool hasClass(char c, uint8_t flags) {
+    return (kCharClasses[static_cast<unsigned char>(c)] & flags) != 0;
+}
+
+#if defined(__AVX2__)
+
+constexpr size_t kBlockSize = 32;
+using BlockMask = uint32_t;
+using Vec = __m256i;
+
+Vec load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const Vec*>(p)); }
+Vec splat(char c) { return _mm256_set1_epi8(c); }
+Vec eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+Vec gt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+Vec vor(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+Vec vand(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+BlockMask bits(Vec v) { return static_cast<BlockMask>(_mm256_movemask_epi8(v)); }
+
+#elif defined(__SSE2__)
+
+constexpr size_t kBlockSize = 16;
+using BlockMask = uint32_t;
+using Vec = __m128i;
+
+Vec load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(p)); }
+Vec splat(char c) { return _mm_set1_epi8(c); }
+Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+Vec gt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+Vec vor(Vec a, Vec b) { return _mm_or_si128(a, b); }
+Vec vand(Vec a, Vec b) { return _mm_and_si128(a, b); }
+BlockMask bits(Vec v) { return static_cast<BlockMask>(_mm_movemask_epi8(v)); }
+
+#endif
+
+#if ATHERIA_LEXER_SIMD
+
+constexpr BlockMask kAllBytes = kBlockSize == 32 ? ~BlockMask(0) : (BlockMask(1) << kBlockSize) - 1;
+
+// Bytes in [lo, hi]. The compares are signed, so bytes >= 0x80 never match.
+Vec inRange(Vec c, char lo, char hi) {
+    return vand(gt(c, splat(static_cast<char>(lo - 1))), gt(splat(static_cast<char>(hi + 1)), c));
 }
 
+BlockMask digitMask(const char* p) {
+    return bits(inRange(load(p), '0', '9'));
+}
+
+BlockMask identifierMask(const char* p) {
+    Vec c = load(p);
+    Vec folded = vor(c, splat(0x20)); // 'A'..'Z' -> 'a'..'z'
+    return bits(vor(vor(inRange(folded, 'a', 'z'), inRange(c, '0', '9')), eq(c, splat('_'))));
+}
+
+BlockMask spaceMask(const char* p, BlockMask& newlines) {
+    Vec c = load(p);
+    Vec newline = eq(c, splat('\n'));
+    newlines = bits(newline);
+    return bits(vor(vor(eq(c, splat(' ')), eq(c, splat('\t'))), vor(eq(c, splat('\r')), newline)));
+}
+
+#endif
+
+// Most runs are short (single spaces, small numbers, names like `x`), and for
+// those one table lookup per byte beats setting up a vector compare. So runs
+// are scanned byte by byte for the first kScalarPrefix bytes and only switch to
+// whole blocks once they turn out to be long.
+constexpr size_t kScalarPrefix = 8;
+
+#if ATHERIA_LEXER_SIMD
+// Returns the first position in [p, end) whose byte isn't in the class
+// described by `blockMask` / `flags`.
+template <BlockMask (*blockMask)(const char*)>
+const char* scanRun(const char* p, const char* end, uint8_t flags) {
+    const char* prefixEnd = static_cast<size_t>(end - p) > kScalarPrefix ? p + kScalarPrefix : end;
+    while (p < prefixEnd) {
+        if (!hasClass(*p, flags)) return p;
+        p++;
+    }
+    while (static_cast<size_t>(end - p) >= kBlockSize) {
+        BlockMask stop = ~blockMask(p) & kAllBytes;
+        if (stop) return p + __builtin_ctz(stop);
+        p += kBlockSize;
+    }
+    while (p < end && hasClass(*p, flags)) p++;
+    return p;
+}
+#endif
+
+// Returns the first position in [p, end) that isn't an identifier character.
+const char* scanIdentifierBody(const char* p, const char* end) {
+#if ATHERIA_LEXER_SIMD
+    return scanRun<identifierMask>(p, end, kIdentBody);
+#else
+    while (p < end && hasClass(*p, kIdentBody)) p++;
+    return p;
+#endif
+}
+
+// Returns the first position in [p, end) that isn't a digit.
+const char* scanDigits(const char* p, const char* end) {
+#if ATHERIA_LEXER_SIMD
+    return scanRun<digitMask>(p, end, kDigit);
+#else
+    while (p < end && hasClass(*p, kDigit)) p++;
+    return p;
+#endif
+}
+
+// --- Keywords ---
+// Keywords are recognized with a perfect hash that is built and checked at
+// compile time: every keyword lands in its own slot, so a lookup is one hash,
+// one table read and at most one short compare. Identifiers that aren't
+// keywords (almost all of them) usually fail on the length check alone.
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+    Symbol symbol; // Pre-interned, so keywords never touch the interner
+};
+
+constexpr Keyword kKeywords[] = {
+    {"return", TokenType::RETURN, sym::Return},
+    {"auto", TokenType::AUTO, sym::Auto},
+    {"constexpr", TokenType::CONSTEXPR, sym::Constexpr},
+    {"export", TokenType::EXPORT, sym::Export},
+    {"static", TokenType::STATIC, sym::Static},
+};
+
+constexpr size_t kKeywordSlots = 16; // Power of two, comfortably more than the keyword count
+
+constexpr size_t keywordHash(std::string_view text) {
+    return (text.size() + static_cast<unsigned char>(text.front()) * 3
+            + static_cast<unsigned char>(text.back())) & (kKeywordSlots - 1);
+}
+
+struct KeywordTable {
+    int8_t slots[kKeywordSlots]; // Index into kKeywords, or -1
+    size_t minLength;
+    size_t maxLength;
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table{};
+    for (auto& slot : table.slots) slot = -1;
+    table.minLength = SIZE_MAX;
+    table.maxLength = 0;
+
+    for (size_t i = 0; i < sizeof(kKeywords) / sizeof(kKeywords[0]); i++) {
+        size_t slot = keywordHash(kKeywords[i].text);
+        // Reaching this throw during constant evaluation is a compile error,
+        // which is exactly what we want if two keywords ever collide.
+        if (table.slots[slot] != -1) throw "keyword hash collision: adjust keywordHash";
+        table.slots[slot] = static_cast<int8_t>(i);
+        if (kKeywords[i].text.size() < table.minLength) table.minLength = kKeywords[i].text.size();
+        if (kKeywords[i].text.size() > table.maxLength) table.maxLength = kKeywords[i].text.size();
+    }
+    return table;
+}
+
+constexpr KeywordTable kKeywordTable = buildKeywordTable();
+
+// Helper function to check for keywords. Returns nullptr for plain identifiers.
+const Keyword* findKeyword(std::string_view text) {
+    if (text.size() < kKeywordTable.minLength || text.size() > kKeywordTable.maxLength) {
+        return nullptr;
+    }
+    int8_t index = kKeywordTable.slots[keywordHash(text)];
+    if (index >= 0 && kKeywords[index].text == text) {
+        return &kKeywords[index];
+    }
+    return nullptr;
+}
+
+} // namespace
+
+Lexer::Lexer(std::string_view source) : m_source(source) {}
+
 Token Lexer::getNextToken() {
+    m_token_count++;
     skipWhitespace();
 
     if (isAtEnd()) {
-        return {TokenType::END_OF_FILE, ""};
+        return makeToken(TokenType::END_OF_FILE, m_current_pos);
     }
 
+    size_t start = m_current_pos;
     char c = advance();
 
     // Handle multi-character tokens first
-    if (isalpha(c) || c == '_') {
+    if (hasClass(c, kIdentStart)) {
         m_current_pos--; // Backtrack to include the first character
         return makeIdentifier();
     }
 
-    if (isdigit(c)) {
+    if (hasClass(c, kDigit)) {
         m_current_pos--; // Backtrack to include the first character
         return makeNumber();
     }
@@ -36,31 +253,36 @@ Token Lexer::getNextToken() {
 
     // Handle single-character tokens
     switch (c) {
-        case '(': return {TokenType::LEFT_PAREN, "("};
-        case ')': return {TokenType::RIGHT_PAREN, ")"};
-        case '{': return {TokenType::LEFT_BRACE, "{"};
-        case '}': return {TokenType::RIGHT_BRACE, "}"};
-        case ';': return {TokenType::SEMICOLON, ";"};
-        case '+': return {TokenType::PLUS, "+"};
-        case '-': return {TokenType::MINUS, "-"};
-        case '*': return {TokenType::STAR, "*"};
-        case '/': return {TokenType::SLASH, "/"};
-        case '=': return {TokenType::EQUAL, "="};
-        case ',': return {TokenType::COMMA, ","};
+        case '(': return makeToken(TokenType::LEFT_PAREN, start);
+        case ')': return makeToken(TokenType::RIGHT_PAREN, start);
+        case '{': return makeToken(TokenType::LEFT_BRACE, start);
+        case '}': return makeToken(TokenType::RIGHT_BRACE, start);
+        case ';': return makeToken(TokenType::SEMICOLON, start);
+        case '+': return makeToken(TokenType::PLUS, start);
+        case '-': return makeToken(TokenType::MINUS, start);
+        case '*': return makeToken(TokenType::STAR, start);
+        case '/': return makeToken(TokenType::SLASH, start);
+        case '=': return makeToken(TokenType::EQUAL, start);
+        case ',': return makeToken(TokenType::COMMA, start);
     }
 
-    return {TokenType::UNKNOWN, std::string(1, c)};
+    return makeToken(TokenType::UNKNOWN, start);
 }
 
 // --- Private Helper Methods ---
 
-bool Lexer::isAtEnd() {
-    return m_current_pos >= m_source.length();
+Token Lexer::makeToken(TokenType type, size_t start) {
+    Token token;
+    token.type = type;
+    token.offset = static_cast<uint32_t>(start);
+    token.length = static_cast<uint32_t>(m_current_pos - start);
+    token.line = m_line;
+    token.column = static_cast<uint32_t>(start - m_line_start + 1);
+    return token;
 }
 
-char Lexer::peek() {
-    if (isAtEnd()) return '\0';
-    return m_source[m_current_pos];
+bool Lexer::isAtEnd() {
+    return m_current_pos >= m_source.length();
 }
 
 char Lexer::advance() {
@@ -68,52 +290,116 @@ char Lexer::advance() {
     return m_source[m_current_pos - 1];
 }
 
+void Lexer::newLine() {
+    m_line++;
+    m_line_start = m_current_pos;
+}
+
 void Lexer::skipWhitespace() {
-    while (true) {
-        char c = peek();
-        switch (c) {
-            case ' ':
-            case '\r':
-            case '\t':
-            case '\n':
-                advance();
-                break;
-            default:
-                return;
+    // Same idea as scanRun: the common single space (or newline) between two
+    // tokens is handled right here, and only longer runs (indentation) are
+    // scanned a block at a time.
+    for (size_t i = 0; i < kScalarPrefix; i++) {
+        if (isAtEnd()) return;
+        char c = m_source[m_current_pos];
+        if (!hasClass(c, kSpace)) return;
+        m_current_pos++;
+        if (c == '\n') newLine();
+    }
+
+#if ATHERIA_LEXER_SIMD
+    const char* begin = m_source.data();
+    const char* end = begin + m_source.size();
+    const char* p = begin + m_current_pos;
+    while (static_cast<size_t>(end - p) >= kBlockSize) {
+        BlockMask newlines;
+        BlockMask stop = ~spaceMask(p, newlines) & kAllBytes;
+        size_t run = stop ? __builtin_ctz(stop) : kBlockSize;
+
+        // Keep the line count right: count the newlines we are skipping over
+        // and remember where the last one was.
+        BlockMask skipped = run == kBlockSize ? kAllBytes : (BlockMask(1) << run) - 1;
+        BlockMask skippedNewlines = newlines & skipped;
+        if (skippedNewlines) {
+            m_line += __builtin_popcount(skippedNewlines);
+            size_t lastNewline = 31 - __builtin_clz(skippedNewlines);
+            m_line_start = static_cast<size_t>(p - begin) + lastNewline + 1;
         }
+
+        p += run;
+        if (run < kBlockSize) {
+            m_current_pos = static_cast<size_t>(p - begin);
+            return;
+        }
+    }
+    m_current_pos = static_cast<size_t>(p - begin);
+#endif
+
+    while (!isAtEnd()) {
+        char c = m_source[m_current_pos];
+        if (!hasClass(c, kSpace)) return;
+        m_current_pos++;
+        if (c == '\n') newLine();
     }
 }
 
 Token Lexer::makeIdentifier() {
     size_t start = m_current_pos;
-    while (isalnum(peek()) || peek() == '_') {
-        advance();
+    const char* begin = m_source.data();
+    const char* end = scanIdentifierBody(begin + start + 1, begin + m_source.size());
+    m_current_pos = static_cast<size_t>(end - begin);
+
+    Token token = makeToken(TokenType::IDENTIFIER, start);
+    std::string_view text = m_source.substr(start, m_current_pos - start);
+    if (const Keyword* keyword = findKeyword(text)) {
+        token.type = keyword->type;
+        token.symbol = keyword->symbol;
+    } else {
+        token.symbol = m_interner.intern(text);
     }
-    std::string text = m_source.substr(start, m_current_pos - start);
-    TokenType type = checkKeyword(text);
-    return {type, text};
+    return token;
 }
 
 Token Lexer::makeString() {
+    // The opening quote is already consumed; the token starts there.
+    size_t quote = m_current_pos - 1;
+    uint32_t line = m_line;
+    uint32_t column = static_cast<uint32_t>(quote - m_line_start + 1);
+
     size_t start = m_current_pos;
-    while (peek() != '"' && !isAtEnd()) {
-        advance();
+    const char* begin = m_source.data();
+    const char* closing = static_cast<const char*>(
+            std::memchr(begin + start, '"', m_source.size() - start));
+    size_t stop = closing ? static_cast<size_t>(closing - begin) : m_source.size();
+
+    // Strings may span lines; keep the line count right.
+    for (const char* p = begin + start; (p = static_cast<const char*>(std::memchr(p, '\n', begin + stop - p)));) {
+        p++;
+        m_line++;
+        m_line_start = static_cast<size_t>(p - begin);
     }
+    m_current_pos = stop;
 
     if (isAtEnd()) {
-        return {TokenType::UNKNOWN, "Unterminated string."};
+        // Unterminated string. The UNKNOWN token covers it, starting at the quote.
+        Token token = makeToken(TokenType::UNKNOWN, quote);
+        token.line = line;
+        token.column = column;
+        return token;
     }
 
+    // The token's text is just the contents, without the quotes.
+    Token token = makeToken(TokenType::STRING_LITERAL, start);
+    token.line = line;
+    token.column = column;
     advance(); // Consume the closing quote.
-    std::string value = m_source.substr(start, m_current_pos - start - 1);
-    return {TokenType::STRING_LITERAL, value};
+    return token;
 }
 
 Token Lexer::makeNumber() {
     size_t start = m_current_pos;
-    while (isdigit(peek())) {
-        advance();
-    }
-    std::string value = m_source.substr(start, m_current_pos - start);
-    return {TokenType::NUMBER_LITERAL, value};
-}
\ No newline at end of file
+    const char* begin = m_source.data();
+    const char* end = scanDigits(begin + start, begin + m_source.size());
+    m_current_pos = static_cast<size_t>(end - begin);
+    return makeToken(TokenType::NUMBER_LITERAL, start);
+}
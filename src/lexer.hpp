@@ -1,26 +1,44 @@
 #pragma once
 #include "token.hpp"
+#include "interner.hpp"
+#include <string_view>
 
 class Lexer {
 public:
-    // Constructor takes the source code to be tokenized
-    Lexer(const std::string& source);
+    // Constructor takes the source code to be tokenized. The source is not
+    // copied: it must outlive the lexer and every token it produces.
+    Lexer(std::string_view source);
 
     // The main function of the lexer. Returns the next token.
     Token getNextToken();
 
+    // The buffer the tokens' offsets refer to.
+    std::string_view source() const { return m_source; }
+
+    // How many tokens getNextToken() has returned so far.
+    size_t tokenCount() const { return m_token_count; }
+
 private:
-    std::string m_source;
+    std::string_view m_source;
+    StringInterner m_interner; // The Symbols of this source's identifiers
     size_t m_current_pos = 0;
+    size_t m_token_count = 0;
+
+    // For source locations
+    uint32_t m_line = 1;
+    size_t m_line_start = 0; // Offset of the first character of the current line
 
     // Helper functions
-    char peek(); // Look at the current character without consuming it
     char advance(); // Consume the current character and move to the next
     bool isAtEnd(); // Check if we've consumed all characters
     void skipWhitespace(); // Skips spaces, tabs, newlines
+    void newLine(); // Called after consuming a '\n'
+
+    // Builds a token covering [start, m_current_pos)
+    Token makeToken(TokenType type, size_t start);
 
-    // Token-specific helpers]
+    // Token-specific helpers
     Token makeNumber();
     Token makeIdentifier();
     Token makeString();
-};
\ No newline at end of file
+};
@@ -0,0 +1,298 @@
+#include "linker.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "llvm/Support/raw_os_ostream.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/Triple.h"
+
+#ifdef ATHERIA_HAVE_LLD
+#include "lld/Common/Driver.h"
+LLD_HAS_DRIVER(elf)
+#endif
+
+extern char** environ;
+
+// --- Memory Files ---
+std::unique_ptr<MemoryFile> MemoryFile::create(const std::string& name, std::ostream& diagnostics) {
+    int fd = ::memfd_create(name.c_str(), MFD_CLOEXEC);
+    if (fd < 0) {
+        diagnostics << "Error: Could not create an in-memory file: " << std::strerror(errno) << "\n";
+        return nullptr;
+    }
+    // Through /proc/<pid> rather than /proc/self, so that a linker we run
+    // as a child process can open it too.
+    std::string path = "/proc/" + std::to_string(::getpid()) + "/fd/" + std::to_string(fd);
+    return std::unique_ptr<MemoryFile>(new MemoryFile(fd, std::move(path)));
+}
+
+MemoryFile::~MemoryFile() {
+    ::close(m_fd);
+}
+
+#ifdef ATHERIA_HAVE_LLD
+// --- System Runtime ---
+// Where the local C runtime lives, looked up once per process.
+struct SystemRuntime {
+    std::string error; // Why we can't link here, if we can't
+
+    std::string emulation;     // The linker's -m
+    std::string dynamicLinker; // The program interpreter executables ask for
+    std::vector<std::string> libraryDirectories;
+
+    // Start files: from libc, and (optionally) from the C compiler.
+    std::string crt1, crti, crtn;
+    std::string crtBegin, crtEnd;
+    bool haveLibgcc = false;
+};
+
+// "12" < "12.2" < "13": compares dotted version numbers component by component.
+static bool olderVersion(const std::string& a, const std::string& b) {
+    auto components = [](const std::string& version) {
+        std::vector<long> numbers;
+        size_t start = 0;
+        while (start <= version.size()) {
+            size_t end = version.find('.', start);
+            if (end == std::string::npos) end = version.size();
+            numbers.push_back(std::strtol(version.c_str() + start, nullptr, 10));
+            start = end + 1;
+        }
+        return numbers;
+    };
+    return components(a) < components(b);
+}
+
+static SystemRuntime findSystemRuntime() {
+    namespace fs = std::filesystem;
+    SystemRuntime runtime;
+    std::error_code ec;
+
+    // 1. What the objects are: CodeGen compiles for the default target triple.
+    llvm::Triple triple(llvm::sys::getDefaultTargetTriple());
+    std::string multiarch;
+    switch (triple.getArch()) {
+        case llvm::Triple::x86_64:
+            multiarch = "x86_64-linux-gnu";
+            runtime.emulation = "elf_x86_64";
+            runtime.dynamicLinker = "/lib64/ld-linux-x86-64.so.2";
+            break;
+        case llvm::Triple::aarch64:
+            multiarch = "aarch64-linux-gnu";
+            runtime.emulation = "aarch64linux";
+            runtime.dynamicLinker = "/lib/ld-linux-aarch64.so.1";
+            break;
+        default:
+            break;
+    }
+    if (multiarch.empty() || !triple.isOSLinux()) {
+        runtime.error = "Linking executables for '" + triple.str() + "' is not supported; use -c and link with cc";
+        return runtime;
+    }
+
+    // 2. The library directories, Debian multiarch style first, then the
+    //    Fedora/Arch ones. libc's start files are in one of them.
+    for (const char* directory : {"/usr/lib/%", "/lib/%", "/usr/lib64", "/lib64", "/usr/lib", "/lib"}) {
+        std::string path = directory;
+        if (size_t marker = path.find('%'); marker != std::string::npos) {
+            path.replace(marker, 1, multiarch);
+        }
+        if (fs::is_directory(path, ec)) {
+            runtime.libraryDirectories.push_back(path);
+        }
+    }
+    for (const std::string& directory : runtime.libraryDirectories) {
+        if (fs::exists(directory + "/Scrt1.o", ec)) {
+            runtime.crt1 = directory + "/Scrt1.o";
+            runtime.crti = directory + "/crti.o";
+            runtime.crtn = directory + "/crtn.o";
+            break;
+        }
+    }
+    if (runtime.crt1.empty()) {
+        runtime.error = "Could not find the C runtime (Scrt1.o); is libc's development package installed?";
+        return runtime;
+    }
+
+    // 3. GCC's own start files and support library, from the newest GCC
+    //    installed for this architecture (/usr/lib/gcc/<triple>/<version>).
+    //    A system without GCC links without them.
+    std::string gccDirectory, gccVersion;
+    std::string arch = triple.getArchName().str();
+    for (const char* base : {"/usr/lib/gcc", "/usr/lib64/gcc"}) {
+        for (const fs::directory_entry& target : fs::directory_iterator(base, ec)) {
+            if (target.path().filename().string().rfind(arch, 0) != 0) continue;
+            for (const fs::directory_entry& version : fs::directory_iterator(target.path(), ec)) {
+                std::string name = version.path().filename().string();
+                if (fs::exists(version.path() / "crtbeginS.o", ec) &&
+                    (gccDirectory.empty() || olderVersion(gccVersion, name))) {
+                    gccDirectory = version.path().string();
+                    gccVersion = name;
+                }
+            }
+        }
+    }
+    if (!gccDirectory.empty()) {
+        runtime.crtBegin = gccDirectory + "/crtbeginS.o";
+        runtime.crtEnd = gccDirectory + "/crtendS.o";
+        runtime.haveLibgcc = true;
+        runtime.libraryDirectories.insert(runtime.libraryDirectories.begin(), gccDirectory);
+    }
+    return runtime;
+}
+
+// --- Linking ---
+// LLD keeps global state while it links, so only one link runs at a time.
+// If it ever reports that it can't run again (after a crash it recovered
+// from), later links in this process fail instead of using broken state.
+static std::mutex linkerMutex;
+static bool linkerUsable = true;
+
+static bool runLld(const std::vector<std::string>& arguments, const std::string& output, std::ostream& diagnostics) {
+    std::vector<const char*> argv;
+    for (const std::string& argument : arguments) {
+        argv.push_back(argument.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(linkerMutex);
+    if (!linkerUsable) {
+        diagnostics << "Error: The linker failed earlier and can't be run again in this process\n";
+        return false;
+    }
+    llvm::raw_os_ostream stream(diagnostics);
+    lld::Result result = lld::lldMain(argv, stream, stream, {{lld::Gnu, &lld::elf::link}});
+    stream.flush();
+    linkerUsable = result.canRunAgain;
+    if (result.retCode != 0) {
+        diagnostics << "Error: Linking '" << output << "' failed\n";
+        return false;
+    }
+    return true;
+}
+#else
+// Runs the C compiler driver on the objects, with its output captured, so
+// that (like every other message) it reaches the client of a compile server.
+static bool runCompilerDriver(const std::vector<std::string>& objects, const std::vector<std::string>& libraries,
+                              const std::string& output, std::ostream& diagnostics) {
+    const char* cc = std::getenv("CC");
+    if (!cc || !*cc) cc = "cc";
+    std::vector<std::string> arguments = {cc, "-o", output};
+    arguments.insert(arguments.end(), objects.begin(), objects.end());
+    arguments.insert(arguments.end(), libraries.begin(), libraries.end());
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+
+    int pipeFds[2];
+    if (::pipe2(pipeFds, O_CLOEXEC) != 0) {
+        diagnostics << "Error: Could not run '" << cc << "': " << std::strerror(errno) << "\n";
+        return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDERR_FILENO);
+    pid_t pid;
+    int error = ::posix_spawnp(&pid, cc, &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(pipeFds[1]);
+    if (error != 0) {
+        ::close(pipeFds[0]);
+        diagnostics << "Error: Could not run '" << cc << "': " << std::strerror(error) << "\n";
+        return false;
+    }
+
+    char buffer[4096];
+    ssize_t got;
+    while ((got = ::read(pipeFds[0], buffer, sizeof(buffer))) != 0) {
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) break;
+        diagnostics.write(buffer, got);
+    }
+    ::close(pipeFds[0]);
+
+    int status;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        diagnostics << "Error: Linking '" << output << "' with '" << cc << "' failed\n";
+        return false;
+    }
+    return true;
+}
+#endif
+
+// compiler-rt's profile runtime: $ATHERIA_PROFILE_RUNTIME, or the one CMake
+// found next to the LLVM `ac` was built with. "" if there is neither.
+static std::string profileRuntime() {
+    if (const char* path = std::getenv("ATHERIA_PROFILE_RUNTIME"); path && *path) {
+        return path;
+    }
+#ifdef ATHERIA_PROFILE_RUNTIME
+    return ATHERIA_PROFILE_RUNTIME;
+#else
+    return "";
+#endif
+}
+
+bool linkExecutable(const std::vector<std::string>& objects, const CompileOptions& options, std::ostream& diagnostics) {
+    const std::string& output = options.output;
+
+    // What the program needs besides the objects and libc. On Linux nothing
+    // refers to the profile runtime's registration hook, so it is pulled in
+    // by name (which is what clang does too).
+    std::vector<std::string> libraries;
+    if (options.profileGenerate) {
+        std::string runtime = profileRuntime();
+        if (runtime.empty()) {
+            diagnostics << "Error: -fprofile-generate needs compiler-rt's profile runtime (libclang_rt.profile.a); "
+                        << "set $ATHERIA_PROFILE_RUNTIME to it\n";
+            return false;
+        }
+        libraries = {"-u", "__llvm_profile_runtime", runtime};
+    }
+
+#ifdef ATHERIA_HAVE_LLD
+    static const SystemRuntime runtime = findSystemRuntime();
+    if (!runtime.error.empty()) {
+        diagnostics << "Error: " << runtime.error << "\n";
+        return false;
+    }
+
+    // The same command line `cc` hands to the linker for a PIE.
+    std::vector<std::string> arguments = {
+        "ld.lld", "--hash-style=gnu", "--build-id", "--eh-frame-hdr", "-m", runtime.emulation,
+        "-pie", "-z", "relro", "-dynamic-linker", runtime.dynamicLinker, "-o", output,
+        runtime.crt1, runtime.crti,
+    };
+    if (!runtime.crtBegin.empty()) arguments.push_back(runtime.crtBegin);
+    for (const std::string& directory : runtime.libraryDirectories) {
+        arguments.push_back("-L" + directory);
+    }
+    arguments.insert(arguments.end(), objects.begin(), objects.end());
+    arguments.insert(arguments.end(), libraries.begin(), libraries.end());
+    auto addLibgcc = [&] {
+        if (!runtime.haveLibgcc) return;
+        arguments.insert(arguments.end(), {"-lgcc", "--as-needed", "-lgcc_s", "--no-as-needed"});
+    };
+    addLibgcc();
+    arguments.push_back("-lc");
+    addLibgcc();
+    if (!runtime.crtEnd.empty()) arguments.push_back(runtime.crtEnd);
+    arguments.push_back(runtime.crtn);
+
+    return runLld(arguments, output, diagnostics);
+#else
+    return runCompilerDriver(objects, libraries, output, diagnostics);
+#endif
+}
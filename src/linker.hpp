@@ -0,0 +1,46 @@
+#pragma once
+#include "options.hpp"
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// --- Linking ---
+// `ac prog.athx -o prog` (any -o name that doesn't end in ".o", without -c)
+// writes an executable instead of an object file. The objects never touch the
+// disk: each one is written to a MemoryFile, and the linker reads it from
+// there. When `ac` is built with LLD (ATHERIA_HAVE_LLD), the link runs inside
+// this process, so building a program costs no extra process spawn. Without
+// LLD, the system's C compiler driver ($CC, or `cc`) is run on the same
+// in-memory objects instead.
+//
+// The program is linked like `cc` would link it: a position independent
+// executable against the C runtime start files (Scrt1.o, crti.o, crtn.o and
+// the compiler's crtbeginS.o/crtendS.o) and the shared libc, all found in the
+// usual places of the local system. Programs built with -fprofile-generate
+// also get compiler-rt's profile runtime, which writes the counts at exit.
+
+// A file that lives in memory (a memfd) but has a path, /proc/<pid>/fd/<n>,
+// so that everything that writes, copies or reads object files by name works
+// on it unchanged. The path stays valid until the MemoryFile is destroyed.
+class MemoryFile {
+public:
+    // Returns nullptr (after printing why) if the system can't make one.
+    static std::unique_ptr<MemoryFile> create(const std::string& name, std::ostream& diagnostics);
+    ~MemoryFile();
+
+    MemoryFile(const MemoryFile&) = delete;
+    MemoryFile& operator=(const MemoryFile&) = delete;
+
+    const std::string& path() const { return m_path; }
+
+private:
+    MemoryFile(int fd, std::string path) : m_fd(fd), m_path(std::move(path)) {}
+
+    int m_fd;
+    std::string m_path;
+};
+
+// Links the object files `objects` with the C runtime and libc into the
+// executable options.output. Returns false (after printing why to `diagnostics`) on failure.
+bool linkExecutable(const std::vector<std::string>& objects, const CompileOptions& options, std::ostream& diagnostics);
@@ -1,65 +1,379 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
 #include <iostream>
-#include <fstream>
-#include <string>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
+#include "cache.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "codegen.hpp"
+#include "simplify.hpp"
+#include "incremental.hpp"
+#include "server.hpp"
+#include "options.hpp"
+#include "jit.hpp"
+#include "linker.hpp"
+#include "source.hpp"
+#include "timing.hpp"
 
-// MODIFIED: run() now takes the output filename as an argument
-void run(const std::string& source, const std::string& out_filename) {
-    // 1. Lexer
+// Reports the object files a compilation wrote, unless they are in-memory
+// files on their way to the linker.
+static void reportObjectFiles(const CompileOptions& options, std::ostream& out, const char* note = "") {
+    if (options.link) {
+        return;
+    }
+    const char* kind = options.emitAssembly ? (options.writesIr() ? "LLVM IR" : "assembly")
+                       : options.writesIr()   ? "LLVM bitcode"
+                                              : "object file";
+    for (const std::string& objectFile : CodeGen::objectFiles(options.output, options)) {
+        out << "Successfully wrote " << kind << " to '" << objectFile << "'" << note << "\n";
+    }
+}
+
+// Compiles one input: lexes, parses, simplifies and generates code, then
+// optimizes and either runs it in the JIT or writes the output files.
+// Returns the process exit code. `options` describes a single input and
+// its output; everything the compilation prints goes to `out` and `err`.
+int run(std::string_view source, const CompileOptions& options, TimeReport& report,
+        std::ostream& out, std::ostream& err) {
+    const std::string& input = options.inputs[0];
+
+    // 1. Lexer + 2. Parser
+    // The parser pulls tokens from the lexer as it goes, so lexing and parsing
+    // are interleaved and the token stream is never stored as a whole.
     Lexer lexer(source);
-    std::vector<Token> tokens;
-    Token token;
-    do {
-        token = lexer.getNextToken();
-        tokens.push_back(token);
-    } while (token.type != TokenType::END_OF_FILE);
-
-    // 2. Parser
-    Parser parser(tokens);
-    std::unique_ptr<ProgramNode> ast = parser.parse();
+    std::unique_ptr<Ast> ast;
+    {
+        TimeReport::Phase phase(report, "Lex + parse", input);
+        Parser parser(lexer, err);
+        ast = parser.parse();
+    }
     if (!ast) {
-        std::cerr << "Compilation failed due to parsing errors." << std::endl;
-        return;
+        err << "Compilation failed due to parsing errors." << std::endl;
+        return 1;
+    }
+    report.addCounter("Tokens", lexer.tokenCount());
+    report.addCounter("AST nodes", ast->nodeCount());
+    report.addCounter("AST bytes", ast->memoryUsage());
+
+    // 2b-5. Incremental mode generates and emits only the functions that
+    // changed. It simplifies the tree itself, after it has seen which
+    // functions call which (calls to constexpr functions are folded away).
+    if (!options.incrementalDir.empty() && !options.run) {
+        if (!compileIncrementally(*ast, options, report, out, err)) {
+            return 1;
+        }
+        reportObjectFiles(options, out);
+        return 0;
+    }
+
+    // 2b. Simplification: constant folding and the like, on the tree
+    {
+        TimeReport::Phase phase(report, "Simplification", input);
+        if (!simplifyAst(*ast, err, ConstexprLimits{options.constexprSteps, options.constexprDepth})) {
+            err << "Compilation failed due to simplification errors." << std::endl;
+            return 1;
+        }
     }
 
     // 3. Code Generation
-    CodeGen generator;
-    generator.generate(ast.get());
+    CodeGen generator(options, out, err);
+    {
+        TimeReport::Phase phase(report, "Code generation", input);
+        if (!generator.generate(*ast)) {
+            err << "Compilation failed due to code generation errors." << std::endl;
+            return 1;
+        }
+
+        // The tree isn't needed past this point; its arrays are freed in one go.
+        ast.reset();
+    }
+    if (report.enabled()) {
+        report.addCounter("Functions", generator.functionCount());
+        report.addCounter("IR instructions", generator.instructionCount());
+    }
+
+    // 4. Optimization (a near no-op at the default -O0)
+    {
+        TimeReport::Phase phase(report, "Optimization", input);
+        if (!generator.optimize()) {
+            return 1;
+        }
+    }
+    if (report.enabled()) {
+        report.addCounter("IR instructions (optimized)", generator.instructionCount());
+    }
 
     // Optional: You can still dump the IR for debugging!
-    std::cout << "--- LLVM IR Generation ---" << std::endl;
-    generator.dump();
+    if (options.dumpIr) {
+        out << "--- LLVM IR Generation ---" << std::endl;
+        generator.dump();
+    }
 
-    // 4. NEW: Emit the actual object file!
-    std::cout << "\n--- Emitting Object File ---" << std::endl;
-    generator.emitObjectFile(out_filename);
+    // 5. Either run the program right here in the JIT...
+    if (options.run) {
+        TimeReport::Phase phase(report, "JIT compile + run", input);
+        return runJit(generator, options);
+    }
+
+    // ...or emit the actual object file!
+    TimeReport::Phase phase(report, "Object emission", input);
+    if (!generator.emitObjectFile(options.output)) {
+        return 1;
+    }
+    reportObjectFiles(options, out);
+    return 0;
 }
 
-// MODIFIED: main() now expects two arguments
-int main(int argc, char** argv) {
-    if (argc != 3) {
-        std::cerr << "Usage: ac <inputfile> <outputfile.o>" << std::endl;
+// Loads one input file and compiles it, or takes its objects from the cache.
+static int compileFile(const CompileOptions& options, ObjectCache* cache, TimeReport& report,
+                       std::ostream& out, std::ostream& err) {
+    // The file is mapped (or, for pipes and stdin, read) once and then
+    // lexed in place; nothing downstream copies it.
+    std::unique_ptr<SourceBuffer> source;
+    {
+        TimeReport::Phase phase(report, "Load source", options.inputs[0]);
+        source = SourceBuffer::open(options.inputs[0], err);
+    }
+    if (!source) {
         return 1;
     }
+    report.addCounter("Source bytes", source->text().size());
 
-    std::string in_filename = argv[1];
-    std::string out_filename = argv[2];
+    // Only object files are cached: --run and --dump-ir need the module itself.
+    std::string cacheKey;
+    std::vector<std::string> objectFiles = CodeGen::objectFiles(options.output, options);
+    if (cache && !options.run && !options.dumpIr) {
+        TimeReport::Phase phase(report, "Cache lookup", options.inputs[0]);
+        cacheKey = cache->key(source->text(), options);
+        if (cache->fetch(cacheKey, objectFiles, err)) {
+            reportObjectFiles(options, out, " (cached)");
+            return 0;
+        }
+    }
 
-    std::ifstream file(in_filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file '" << in_filename << "'" << std::endl;
-        return 1;
+    int exitCode = run(source->text(), options, report, out, err);
+    if (exitCode == 0 && !cacheKey.empty()) {
+        TimeReport::Phase phase(report, "Cache store", options.inputs[0]);
+        cache->store(cacheKey, objectFiles, err);
     }
+    return exitCode;
+}
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
+// --- Parallel Compilation ---
+// Every input file is an independent compilation with its own LLVMContext,
+// module and TargetMachine, so files can be compiled on separate threads
+// without sharing anything but the TimeReport.
+// Each job's output is buffered and printed once it is done, in input order,
+// so the log reads the same no matter how the threads were scheduled.
+struct CompileJob {
+    CompileOptions options; // inputs[0] is this job's file, output its object file(s)
+    std::ostringstream out;
+    std::ostringstream err;
+    int exitCode = 0;
+    bool finished = false; // Guarded by the pool's mutex
+};
 
-    run(source, out_filename);
+// Prints `text` with every line prefixed by the file it is about.
+static void printPrefixed(std::ostream& stream, const std::string& file, const std::string& text) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        end = end == std::string::npos ? text.size() : end + 1;
+        stream << file << ": " << std::string_view(text).substr(start, end - start);
+        start = end;
+    }
+    if (!text.empty() && text.back() != '\n') {
+        stream << '\n';
+    }
+}
+
+// Compiles the single input of every entry of `jobOptions`, on up to -j threads.
+static int compileJobs(std::vector<CompileOptions> jobOptions, ObjectCache* cache, TimeReport& report,
+                       std::ostream& out, std::ostream& err) {
+    // A single file is compiled right here, printing as it goes.
+    if (jobOptions.size() == 1) {
+        return compileFile(jobOptions[0], cache, report, out, err);
+    }
+
+    unsigned threadCount = std::min<size_t>(jobOptions[0].jobs, jobOptions.size());
+    std::vector<std::unique_ptr<CompileJob>> jobs;
+    for (CompileOptions& single : jobOptions) {
+        auto job = std::make_unique<CompileJob>();
+        job->options = std::move(single);
+        jobs.push_back(std::move(job));
+    }
+
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable done;
+
+    // 1. The workers take the next job that nobody has started yet.
+    auto worker = [&]() {
+        TimeReport::ThreadScope traceScope(report);
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            CompileJob& job = *jobs[i];
+            int exitCode = compileFile(job.options, cache, report, job.out, job.err);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            job.exitCode = exitCode;
+            job.finished = true;
+            done.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
 
+    // 2. Meanwhile, print each job's output as soon as it and every job
+    //    before it have finished.
+    int exitCode = 0;
+    for (auto& job : jobs) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&] { return job->finished; });
+        }
+        printPrefixed(err, job->options.inputs[0], job->err.str());
+        out << job->out.str() << std::flush;
+        if (job->exitCode != 0) {
+            exitCode = 1;
+        }
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return exitCode;
+}
+
+// Compiles every input to its object file(s).
+static int compileAll(const CompileOptions& options, ObjectCache* cache, TimeReport& report,
+                      std::ostream& out, std::ostream& err) {
+    if (options.inputs.size() == 1) {
+        return compileJobs({options}, cache, report, out, err);
+    }
+
+    std::vector<CompileOptions> jobOptions;
+    for (const std::string& input : options.inputs) {
+        CompileOptions& job = jobOptions.emplace_back(options);
+        job.inputs = {input};
+        job.output = (std::filesystem::path(options.outputDirectory) / objectFileFor(input, options)).string();
+    }
+    return compileJobs(std::move(jobOptions), cache, report, out, err);
+}
+
+// Compiles every input into in-memory object files and links them into the
+// program options.output (see linker.hpp).
+static int compileAndLink(const CompileOptions& options, ObjectCache* cache, TimeReport& report,
+                          std::ostream& out, std::ostream& err) {
+    // 1. One in-memory file per object: each input gets options.partitions().
+    std::vector<std::unique_ptr<MemoryFile>> memoryFiles;
+    std::vector<std::string> objects;
+    std::vector<CompileOptions> jobOptions;
+    for (const std::string& input : options.inputs) {
+        CompileOptions& job = jobOptions.emplace_back(options);
+        job.inputs = {input};
+        for (unsigned i = 0; i < options.partitions(); i++) {
+            auto memoryFile = MemoryFile::create(objectFileFor(input, options), err);
+            if (!memoryFile) {
+                return 1;
+            }
+            job.objectFileOverride.push_back(memoryFile->path());
+            objects.push_back(memoryFile->path());
+            memoryFiles.push_back(std::move(memoryFile));
+        }
+        job.output = job.objectFileOverride[0];
+    }
+
+    // 2. Compile them, in parallel with -j.
+    if (compileJobs(std::move(jobOptions), cache, report, out, err) != 0) {
+        return 1;
+    }
+
+    // 3. Link.
+    {
+        TimeReport::Phase phase(report, "Link", options.output);
+        if (!linkExecutable(objects, options, err)) {
+            return 1;
+        }
+    }
+    out << "Successfully linked executable '" << options.output << "'\n";
     return 0;
-}
\ No newline at end of file
+}
+
+// Everything one `ac` command does once its options are parsed.
+static int compileCommand(const CompileOptions& options, std::ostream& out, std::ostream& err) {
+    std::unique_ptr<ObjectCache> cache;
+    if (!options.cacheDir.empty()) {
+        cache = std::make_unique<ObjectCache>(options.cacheDir, options.cacheSize);
+    }
+
+    TimeReport report(options);
+    int exitCode = 0;
+    if (options.link) {
+        exitCode = compileAndLink(options, cache.get(), report, out, err);
+    } else if (!options.inputs.empty()) {
+        exitCode = compileAll(options, cache.get(), report, out, err);
+    }
+    if (!report.finish() && exitCode == 0) {
+        exitCode = 1;
+    }
+    if (options.cacheStats) {
+        cache->printStats(out);
+    }
+    return exitCode;
+}
+
+// A request to the compile server: the client's command line, run from the client's directory.
+static int serveRequest(const std::vector<std::string>& arguments, const std::string& directory,
+                        std::ostream& out, std::ostream& err) {
+    std::vector<std::string> storage = {"ac"};
+    storage.insert(storage.end(), arguments.begin(), arguments.end());
+    std::vector<char*> argv;
+    for (std::string& argument : storage) {
+        argv.push_back(argument.data());
+    }
+
+    CompileOptions options;
+    if (!parseCommandLine(static_cast<int>(argv.size()), argv.data(), options, err)) {
+        return 1;
+    }
+    // These print straight to the server's own stdout, or change process-wide state.
+    if (options.run || options.timeReport || !options.traceFile.empty() || !options.serverSocket.empty()) {
+        err << "Error: The compile server can't do --run, --time-report, --trace or --server" << std::endl;
+        return 1;
+    }
+    resolvePaths(options, directory);
+    return compileCommand(options, out, err);
+}
+
+int main(int argc, char** argv) {
+    CompileOptions options;
+    applyEnvironment(options);
+    if (!parseCommandLine(argc, argv, options, std::cerr)) {
+        return 1;
+    }
+
+    if (!options.serverSocket.empty()) {
+        return runServer(options.serverSocket, serveRequest);
+    }
+
+    // With a compile server around, let it do the work.
+    if (!options.connectSocket.empty() && canForward(options)) {
+        int exitCode;
+        if (forwardCommandLine(options, argc, argv, exitCode)) {
+            return exitCode;
+        }
+        // Nobody is listening: compile right here.
+    }
+
+    return compileCommand(options, std::cout, std::cerr);
+}
@@ -0,0 +1,348 @@
+#include "options.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <ostream>
+
+void printUsage(std::ostream& diagnostics) {
+    diagnostics << "Usage: ac [options] <inputfile> <outputfile.o>\n"
+              << "       ac [options] <inputfile> -o <outputfile.o>\n"
+              << "       ac [options] <inputfile>... -o <program>\n"
+              << "       ac [options] <inputfile>...\n"
+              << "       ac [options] --run <inputfile>\n"
+              << "\n"
+              << "Options:\n"
+              << "  -O0, -O1, -O2, -O3, -Os   Optimization level (default: -O0)\n"
+              << "  -o <file>                 Write the output to <file> (default: <input>.o); unless\n"
+              << "                            it ends in .o, link the inputs into a program <file>\n"
+              << "  -c                        Only compile: write an object file even for -o <program>\n"
+              << "  -S                        Write assembly (.s) instead of an object file\n"
+              << "  -emit-llvm                Write LLVM bitcode (.bc), or with -S textual LLVM IR (.ll)\n"
+              << "  -flto=thin                Write bitcode with a ThinLTO summary (.o) that clang and\n"
+              << "                            lld can optimize together with C/C++ at link time\n"
+              << "  -j <n>                    Compile up to <n> input files at the same time\n"
+              << "  --codegen-threads=<n>     Generate machine code on <n> threads, into <n> object\n"
+              << "                            files: out.o, out.1.o, ... (all of them must be linked)\n"
+              << "  -march=native             Tune for and use every feature of the host CPU\n"
+              << "  -mcpu=<name>              Target a specific CPU (default: generic)\n"
+              << "  -mattr=<+feat,-feat,...>  Enable or disable individual target features\n"
+              << "  -fprofile-generate[=<dir>]\n"
+              << "                            Instrument the program to write an execution profile to\n"
+              << "                            <dir>/default_%m.profraw (merge it with llvm-profdata)\n"
+              << "  -fprofile-use=<file>      Optimize with the merged profile <file> (.profdata)\n"
+              << "  -fconstexpr-steps=<n>     Give up evaluating a constexpr call at compile time after\n"
+              << "                            <n>[K|M] steps (default: 1M)\n"
+              << "  -fconstexpr-depth=<n>     ... or when calls nest <n> deep (default: 512)\n"
+              << "  --run                     JIT-compile the program and run its main()\n"
+              << "  --lazy                    Like --run, but compile each function on first call\n"
+              << "  --dump-ir                 Print the generated LLVM IR to stderr\n"
+              << "  --incremental=<dir>       Only recompile the parts of each input that changed since\n"
+              << "                            the last build into <dir>, into <n> object files\n"
+              << "  --incremental-chunks=<n>  (default: 16) that must all be linked: out.o, out.1.o, ...\n"
+              << "  --cache-dir=<dir>         Reuse object files compiled before (or $ATHERIA_CACHE_DIR)\n"
+              << "  --cache-size=<n>[K|M|G]   Evict the least recently used objects beyond this (default: 1G)\n"
+              << "  --cache-stats             Print the cache's size and hit rate (no input needed)\n"
+              << "  --time-report             Print time, memory and counters for each phase and pass\n"
+              << "  --trace=<file.json>       Write the same as a Chrome trace (chrome://tracing)\n"
+              << "  --server=<socket>         Run as a compile server listening on a Unix socket\n"
+              << "  --connect=<socket>        Have that server compile (or $ATHERIA_SERVER); compiles\n"
+              << "                            right here if no server is running\n";
+}
+
+std::string optLevelToString(OptLevel level) {
+    switch (level) {
+        case OptLevel::O0: return "-O0";
+        case OptLevel::O1: return "-O1";
+        case OptLevel::O2: return "-O2";
+        case OptLevel::O3: return "-O3";
+        case OptLevel::Os: return "-Os";
+    }
+    return "-O0";
+}
+
+const char* outputExtension(const CompileOptions& options) {
+    if (options.emitAssembly) {
+        return options.writesIr() ? ".ll" : ".s";
+    }
+    return options.emitLlvm ? ".bc" : ".o";
+}
+
+std::string objectFileFor(const std::string& input, const CompileOptions& options) {
+    std::filesystem::path path(input);
+    return path.stem().string() + outputExtension(options);
+}
+
+// Parses the N of "-j N", "-jN", "--codegen-threads=N" and the like.
+static bool parseCount(const char* option, const std::string& text, unsigned& count, std::ostream& diagnostics) {
+    if (text.empty() || text.size() > 4 || text.find_first_not_of("0123456789") != std::string::npos) {
+        diagnostics << "Error: '" << option << "' expects a number, not '" << text << "'" << std::endl;
+        return false;
+    }
+    count = static_cast<unsigned>(std::stoul(text));
+    if (count == 0) {
+        diagnostics << "Error: '" << option << "' must be at least 1" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Parses "123", "64K", "16M", "1G" (powers of 1024).
+static bool parseSize(std::string text, uint64_t& size) {
+    uint64_t multiplier = 1;
+    if (!text.empty()) {
+        switch (text.back()) {
+            case 'K': case 'k': multiplier = 1ull << 10; text.pop_back(); break;
+            case 'M': case 'm': multiplier = 1ull << 20; text.pop_back(); break;
+            case 'G': case 'g': multiplier = 1ull << 30; text.pop_back(); break;
+        }
+    }
+    if (text.empty() || text.size() > 12 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    size = std::stoull(text) * multiplier;
+    return size > 0;
+}
+
+bool parseCommandLine(int argc, char** argv, CompileOptions& options, std::ostream& diagnostics) {
+    std::vector<std::string> positional;
+
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "-O0") { options.optLevel = OptLevel::O0; continue; }
+        if (arg == "-O1") { options.optLevel = OptLevel::O1; continue; }
+        if (arg == "-O2" || arg == "-O") { options.optLevel = OptLevel::O2; continue; }
+        if (arg == "-O3") { options.optLevel = OptLevel::O3; continue; }
+        if (arg == "-Os") { options.optLevel = OptLevel::Os; continue; }
+
+        if (arg == "-o") {
+            if (i + 1 >= argc) {
+                diagnostics << "Error: '-o' expects a file name" << std::endl;
+                return false;
+            }
+            options.output = argv[++i];
+            continue;
+        }
+
+        if (arg == "-c") { options.compileOnly = true; continue; }
+        if (arg == "-S") { options.emitAssembly = true; continue; }
+        if (arg == "-emit-llvm") { options.emitLlvm = true; continue; }
+        if (arg == "-flto=thin") { options.thinLto = true; continue; }
+        if (arg == "-fprofile-generate" || arg.rfind("-fprofile-generate=", 0) == 0) {
+            // Like clang: "%m" makes every instrumented binary write its own file.
+            std::string directory = arg.size() > 18 ? arg.substr(19) : "";
+            options.profileGenerate = true;
+            options.profileRawFile = directory.empty() ? "default_%m.profraw" : directory + "/default_%m.profraw";
+            continue;
+        }
+        if (arg.rfind("-fprofile-use=", 0) == 0) {
+            options.profileUse = arg.substr(14);
+            if (options.profileUse.empty()) {
+                diagnostics << "Error: '-fprofile-use=' expects a .profdata file" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (arg.rfind("-fconstexpr-steps=", 0) == 0 || arg.rfind("-fconstexpr-depth=", 0) == 0) {
+            std::string option = arg.substr(0, 17);
+            uint64_t limit = 0;
+            if (!parseSize(arg.substr(18), limit) || limit > UINT32_MAX) {
+                diagnostics << "Error: '" << option << "' expects a number like 1000 or 4M, not '" << arg.substr(18) << "'" << std::endl;
+                return false;
+            }
+            (option == "-fconstexpr-steps" ? options.constexprSteps : options.constexprDepth) = static_cast<uint32_t>(limit);
+            continue;
+        }
+        if (arg == "-flto" || arg == "-flto=full") {
+            diagnostics << "Error: Only ThinLTO is supported; use '-flto=thin'" << std::endl;
+            return false;
+        }
+
+        if (arg == "-j") {
+            if (i + 1 >= argc) {
+                diagnostics << "Error: '-j' expects a number of jobs" << std::endl;
+                return false;
+            }
+            if (!parseCount("-j", argv[++i], options.jobs, diagnostics)) return false;
+            continue;
+        }
+        if (arg.rfind("-j", 0) == 0) {
+            if (!parseCount("-j", arg.substr(2), options.jobs, diagnostics)) return false;
+            continue;
+        }
+        if (arg.rfind("--codegen-threads=", 0) == 0) {
+            if (!parseCount("--codegen-threads", arg.substr(18), options.codegenThreads, diagnostics)) return false;
+            continue;
+        }
+
+        if (arg == "--dump-ir") { options.dumpIr = true; continue; }
+        if (arg == "--run") { options.run = true; continue; }
+        if (arg == "--lazy") { options.run = true; options.lazyJit = true; continue; }
+        if (arg == "--time-report") { options.timeReport = true; continue; }
+        if (arg.rfind("--trace=", 0) == 0) {
+            options.traceFile = arg.substr(8);
+            if (options.traceFile.empty()) {
+                diagnostics << "Error: '--trace=' expects a file name" << std::endl;
+                return false;
+            }
+            continue;
+        }
+
+        if (arg.rfind("--cache-dir=", 0) == 0) { options.cacheDir = arg.substr(12); continue; }
+        if (arg.rfind("--cache-size=", 0) == 0) {
+            if (!parseSize(arg.substr(13), options.cacheSize)) {
+                diagnostics << "Error: '--cache-size' expects a size like 500M, not '" << arg.substr(13) << "'" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (arg == "--cache-stats") { options.cacheStats = true; continue; }
+        if (arg.rfind("--server=", 0) == 0) { options.serverSocket = arg.substr(9); continue; }
+        if (arg.rfind("--connect=", 0) == 0) { options.connectSocket = arg.substr(10); continue; }
+        if (arg.rfind("--incremental=", 0) == 0) {
+            options.incrementalDir = arg.substr(14);
+            if (options.incrementalDir.empty()) {
+                diagnostics << "Error: '--incremental=' expects a directory" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (arg.rfind("--incremental-chunks=", 0) == 0) {
+            if (!parseCount("--incremental-chunks", arg.substr(21), options.incrementalChunks, diagnostics)) return false;
+            continue;
+        }
+
+        // -march and -mcpu are the same thing for us: "native" is resolved
+        // against the host when the TargetMachine is created.
+        if (arg.rfind("-march=", 0) == 0) { options.cpu = arg.substr(7); continue; }
+        if (arg.rfind("-mcpu=", 0) == 0) { options.cpu = arg.substr(6); continue; }
+        if (arg.rfind("-mattr=", 0) == 0) {
+            if (!options.features.empty()) options.features += ",";
+            options.features += arg.substr(7);
+            continue;
+        }
+
+        // A lone "-" is not an option: it means "read the program from stdin".
+        if (arg.size() > 1 && arg[0] == '-') {
+            diagnostics << "Error: Unknown option '" << arg << "'" << std::endl;
+            return false;
+        }
+
+        positional.push_back(arg);
+    }
+
+    // The original spelling `ac <inputfile> <outputfile.o>` is still accepted.
+    auto endsWith = [](const std::string& text, const char* suffix) {
+        size_t length = std::char_traits<char>::length(suffix);
+        return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+    };
+    if (options.output.empty() && positional.size() == 2 && !options.run && endsWith(positional.back(), ".o")) {
+        options.output = positional.back();
+        positional.pop_back();
+    }
+
+    // An -o that doesn't name an object file asks for a program. Assembly
+    // and LLVM IR are never linked; ThinLTO objects are, by LLD.
+    options.link = !options.output.empty() && !options.compileOnly && !options.run && !options.emitAssembly &&
+                   !options.emitLlvm && !endsWith(options.output, ".o");
+
+    if (options.run && (options.emitAssembly || options.writesIr())) {
+        diagnostics << "Error: '--run' writes no file; it can't be combined with -S, -emit-llvm or -flto=thin" << std::endl;
+        return false;
+    }
+    if (options.profileGenerate && !options.profileUse.empty()) {
+        diagnostics << "Error: '-fprofile-generate' and '-fprofile-use' can't be combined" << std::endl;
+        return false;
+    }
+    if (options.run && options.profileGenerate) {
+        diagnostics << "Error: '--run' can't use the profile runtime; build the program with -o instead" << std::endl;
+        return false;
+    }
+    if (options.writesIr() && options.codegenThreads > 1) {
+        diagnostics << "Error: '--codegen-threads' splits machine code; it can't be combined with -emit-llvm or -flto=thin" << std::endl;
+        return false;
+    }
+    if (!options.incrementalDir.empty() && options.codegenThreads > 1) {
+        diagnostics << "Error: '--incremental' already splits the code; it can't be combined with '--codegen-threads'" << std::endl;
+        return false;
+    }
+    if (options.cacheStats && options.cacheDir.empty()) {
+        diagnostics << "Error: '--cache-stats' needs a cache directory (--cache-dir=<dir>)" << std::endl;
+        return false;
+    }
+
+    // `ac --cache-stats` on its own only prints the statistics, and a server
+    // gets its inputs from its clients.
+    if (positional.empty() && (options.cacheStats || !options.serverSocket.empty())) {
+        return true;
+    }
+    if (positional.empty()) {
+        printUsage(diagnostics);
+        return false;
+    }
+    options.inputs = positional;
+
+    if (options.inputs.size() == 1) {
+        // Nothing is written to disk when running in the JIT.
+        if (options.output.empty() && !options.run) {
+            options.output = options.inputs[0] == "-" ? std::string("a") + outputExtension(options)
+                                                      : objectFileFor(options.inputs[0], options);
+        }
+        return true;
+    }
+
+    // Several inputs: each one is compiled to its own object file, and
+    // those are either linked together or written out.
+    if (options.run) {
+        diagnostics << "Error: '--run' takes exactly one input file" << std::endl;
+        return false;
+    }
+    if (!options.output.empty() && !options.link) {
+        diagnostics << "Error: '-o' can't name one object file for more than one input file" << std::endl;
+        return false;
+    }
+    std::map<std::string, std::string> inputsByOutput;
+    for (const std::string& input : options.inputs) {
+        if (input == "-") {
+            diagnostics << "Error: '-' (stdin) must be the only input file" << std::endl;
+            return false;
+        }
+        if (options.link) {
+            continue; // The objects only exist in memory
+        }
+        auto [it, inserted] = inputsByOutput.emplace(objectFileFor(input, options), input);
+        if (!inserted) {
+            diagnostics << "Error: '" << it->second << "' and '" << input
+                      << "' would both be compiled to '" << it->first << "'" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void applyEnvironment(CompileOptions& options) {
+    if (const char* cacheDir = std::getenv("ATHERIA_CACHE_DIR")) {
+        options.cacheDir = cacheDir;
+    }
+    if (const char* server = std::getenv("ATHERIA_SERVER")) {
+        options.connectSocket = server;
+    }
+}
+
+void resolvePaths(CompileOptions& options, const std::string& directory) {
+    auto resolve = [&](std::string& path) {
+        if (!path.empty() && path != "-" && std::filesystem::path(path).is_relative()) {
+            path = (std::filesystem::path(directory) / path).lexically_normal().string();
+        }
+    };
+    for (std::string& input : options.inputs) {
+        resolve(input);
+    }
+    resolve(options.output);
+    resolve(options.cacheDir);
+    resolve(options.incrementalDir);
+    resolve(options.traceFile);
+    resolve(options.profileUse);
+    options.outputDirectory = directory;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The optimization levels accepted on the command line (-O0 ... -O3, -Os).
+enum class OptLevel {
+    O0, // No optimization, fastest compile (the default)
+    O1,
+    O2,
+    O3,
+    Os  // Optimize for size
+};
+
+// Everything the driver needs to know about a single invocation of `ac`.
+struct CompileOptions {
+    // Each input is compiled on its own into an object file. With a single
+    // input, `output` is its object file; with several, every input gets
+    // objectFileFor(input) and `output` is left empty. When linking, `output`
+    // is the program and the objects are only kept in memory.
+    std::vector<std::string> inputs;
+    std::string output;
+    std::string outputDirectory; // Where objectFileFor() names are put ("" is the current directory)
+
+    // Executables (see linker.hpp): an -o that doesn't end in ".o" names a
+    // program to link from all the inputs, unless -c is given.
+    bool compileOnly = false; // -c: always write object files
+    bool link = false;        // Worked out by parseCommandLine
+    // While linking, the files each input's objects go to instead of
+    // CodeGen::objectFiles(output): in-memory files, one per partition.
+    std::vector<std::string> objectFileOverride;
+
+    unsigned jobs = 1;           // -j N: how many files to compile at the same time
+    unsigned codegenThreads = 1; // --codegen-threads=N: split each module into N objects, emitted in parallel
+
+    OptLevel optLevel = OptLevel::O0;
+
+    // Target selection. "native" means "whatever CPU we are running on".
+    std::string cpu = "generic";  // -mcpu=<name>, -march=<name|native>
+    std::string features;         // -mattr=+avx2,-sse4a,...
+
+    bool dumpIr = false; // --dump-ir: print the final LLVM IR to stderr
+
+    // What the inputs are compiled to: machine code unless one of these is
+    // given. The default output names follow (see outputExtension).
+    bool emitAssembly = false; // -S: assembly (.s), or with -emit-llvm/-flto=thin textual IR (.ll)
+    bool emitLlvm = false;     // -emit-llvm: LLVM bitcode (.bc)
+    bool thinLto = false;      // -flto=thin: bitcode with a ThinLTO summary (.o), for clang and lld to link
+    bool writesIr() const { return emitLlvm || thinLto; }
+
+    // Profile-guided optimization: build an instrumented program, run it on
+    // a real workload, merge what it wrote with llvm-profdata, and compile
+    // again with the result (see bench/pgo/run.sh).
+    bool profileGenerate = false; // -fprofile-generate[=<dir>]: count how often every function and call runs
+    std::string profileRawFile;   //   where the program writes the counts ($LLVM_PROFILE_FILE overrides it)
+    std::string profileUse;       // -fprofile-use=<file.profdata>: optimize for those counts
+
+    // How far calls to constexpr functions are evaluated at compile time (see consteval.hpp).
+    uint32_t constexprSteps = 1048576; // -fconstexpr-steps=<n>: expressions and statements per call site
+    uint32_t constexprDepth = 512;     // -fconstexpr-depth=<n>: calls in progress at once
+
+    // JIT mode: run `main` in-process instead of writing an object file.
+    bool run = false;    // --run
+    bool lazyJit = false; // --lazy: only compile functions when they are first called
+
+    // Object file cache (see cache.hpp). Off unless a directory is given.
+    std::string cacheDir;                  // --cache-dir=<dir>, or $ATHERIA_CACHE_DIR
+    uint64_t cacheSize = 1024ull << 20;    // --cache-size=<n>[K|M|G]: evict beyond this
+    bool cacheStats = false;               // --cache-stats: print hits, misses and size
+
+    // Incremental compilation (see incremental.hpp)
+    std::string incrementalDir;     // --incremental=<dir>: reuse the chunks with no changed function
+    unsigned incrementalChunks = 16; // --incremental-chunks=N: object files per input in that mode
+
+    // How many object files each input is compiled into (see CodeGen::objectFiles).
+    unsigned partitions() const { return incrementalDir.empty() ? codegenThreads : incrementalChunks; }
+
+    // Compile server (see server.hpp)
+    std::string serverSocket;  // --server=<socket>: serve compile requests on this Unix socket
+    std::string connectSocket; // --connect=<socket> or $ATHERIA_SERVER: let that server compile
+
+    // Instrumentation (see timing.hpp)
+    bool timeReport = false; // --time-report: phase times, memory, counters and pass times on stdout
+    std::string traceFile;   // --trace=<file>: the same as a Chrome trace
+};
+
+// Turns argv into a CompileOptions. Prints the problem to `diagnostics` and
+// returns false on bad usage.
+bool parseCommandLine(int argc, char** argv, CompileOptions& options, std::ostream& diagnostics);
+
+// Takes defaults from the environment ($ATHERIA_CACHE_DIR, $ATHERIA_SERVER).
+// Called before parseCommandLine, so that flags win.
+void applyEnvironment(CompileOptions& options);
+
+// Makes every relative path in `options` relative to `directory` instead of
+// the current directory (for the compile server, which runs somewhere else).
+void resolvePaths(CompileOptions& options, const std::string& directory);
+
+// Prints the usage text.
+void printUsage(std::ostream& diagnostics);
+
+// The extension of what the inputs are compiled to: ".o", ".s", ".bc" or ".ll".
+// ThinLTO bitcode keeps ".o", as it stands in for an object file.
+const char* outputExtension(const CompileOptions& options);
+
+// The default output file for an input: its name with the extension replaced
+// by outputExtension(options), in the current directory (like `cc -c`).
+std::string objectFileFor(const std::string& input, const CompileOptions& options);
+
+// Handy for diagnostics and for the "-O2" style spelling of a level.
+std::string optLevelToString(OptLevel level);
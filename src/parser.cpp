@@ -1,59 +1,82 @@
 #include "parser.hpp"
 #include <iostream>
 
-Parser::Parser(const std::vector<Token>& tokens) : m_tokens(tokens) {}
-
-std::unique_ptr<ProgramNode> Parser::parse() {
-    auto program = std::make_unique<ProgramNode>();
+Parser::Parser(Lexer& lexer, std::ostream& diagnostics)
+    : m_lexer(lexer), m_source(lexer.source()), m_diagnostics(diagnostics) {}
+
+std::unique_ptr<Ast> Parser::parse() {
+    m_ast = std::make_unique<Ast>(m_source);
+    // We don't know the token count up front; programs average a token
+    // every five or six bytes of source.
+    m_ast->reserve(m_source.size() / 6);
+    std::vector<NodeIndex> functions;
     while (!isAtEnd()) {
-        auto funcDef = parseFunctionDefinition();
-        if (!funcDef) return nullptr;
-        program->functions.push_back(std::move(funcDef));
+        NodeIndex funcDef = parseFunctionDefinition();
+        if (funcDef == kNoNode) return nullptr;
+        functions.push_back(funcDef);
     }
-    return program;
+    m_ast->addProgram(functions);
+    return std::move(m_ast);
 }
 
-std::unique_ptr<FunctionDefinitionNode> Parser::parseFunctionDefinition() {
-    auto funcDef = std::make_unique<FunctionDefinitionNode>();
-    if (!consume(TokenType::IDENTIFIER, "Expect return type.")) return nullptr;
-    funcDef->returnType = previous();
-    if (!consume(TokenType::IDENTIFIER, "Expect function name.")) return nullptr;
-    funcDef->functionName = previous();
-    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after function name.")) return nullptr;
+NodeIndex Parser::parseFunctionDefinition() {
+    // Qualifiers come in any order, each at most once.
+    uint32_t qualifiers = 0;
+    while (check(TokenType::CONSTEXPR) || check(TokenType::EXPORT) || check(TokenType::STATIC)) {
+        Token token = advance();
+        uint32_t bit = token.type == TokenType::CONSTEXPR ? qualifier::Constexpr
+                     : token.type == TokenType::EXPORT ? qualifier::Export
+                     : qualifier::Static;
+        if (qualifiers & bit) {
+            error(token, "Duplicate '" + std::string(token.text(m_source)) + "'.");
+            return kNoNode;
+        }
+        qualifiers |= bit;
+        if ((qualifiers & qualifier::Export) && (qualifiers & qualifier::Static)) {
+            error(token, "A function can't be both 'export' and 'static'.");
+            return kNoNode;
+        }
+    }
+    if (!consume(TokenType::IDENTIFIER, "Expect return type.")) return kNoNode;
+    TokenIndex returnType = storePrevious();
+    if (!consume(TokenType::IDENTIFIER, "Expect function name.")) return kNoNode;
+    TokenIndex functionName = storePrevious();
+    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after function name.")) return kNoNode;
 
+    std::vector<NodeIndex> parameters;
     if (!check(TokenType::RIGHT_PAREN)) {
         do {
-            auto param = parseParameter();
-            if (!param) return nullptr;
-            funcDef->parameters.push_back(std::move(param));
+            NodeIndex param = parseParameter();
+            if (param == kNoNode) return kNoNode;
+            parameters.push_back(param);
         } while (consume(TokenType::COMMA, ""));
     }
 
-    if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.")) return nullptr;
-    if (!consume(TokenType::LEFT_BRACE, "Expect '{' before function body.")) return nullptr;
+    if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.")) return kNoNode;
+    if (!consume(TokenType::LEFT_BRACE, "Expect '{' before function body.")) return kNoNode;
 
+    std::vector<NodeIndex> body;
     while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
-        auto stmt = parseStatement();
-        if (!stmt) return nullptr;
-        funcDef->body.push_back(std::move(stmt));
+        NodeIndex stmt = parseStatement();
+        if (stmt == kNoNode) return kNoNode;
+        body.push_back(stmt);
     }
 
-    if (!consume(TokenType::RIGHT_BRACE, "Expect '}' after function body.")) return nullptr;
-    return funcDef;
+    if (!consume(TokenType::RIGHT_BRACE, "Expect '}' after function body.")) return kNoNode;
+    return m_ast->addFunction(qualifiers, returnType, functionName, parameters, body);
 }
 
-std::unique_ptr<ParameterNode> Parser::parseParameter() {
-    auto param = std::make_unique<ParameterNode>();
-    if (!consume(TokenType::IDENTIFIER, "Expect parameter type.")) return nullptr;
-    param->type = previous();
-    if (!consume(TokenType::IDENTIFIER, "Expect parameter name.")) return nullptr;
-    param->name = previous();
-    return param;
+NodeIndex Parser::parseParameter() {
+    if (!consume(TokenType::IDENTIFIER, "Expect parameter type.")) return kNoNode;
+    TokenIndex type = storePrevious();
+    if (!consume(TokenType::IDENTIFIER, "Expect parameter name.")) return kNoNode;
+    TokenIndex name = storePrevious();
+    return m_ast->addNode(NodeKind::Parameter, name, type);
 }
 
 // In src/parser.cpp
 
-std::unique_ptr<StatementNode> Parser::parseStatement() {
+NodeIndex Parser::parseStatement() {
     if (check(TokenType::RETURN)) {
         return parseReturnStatement();
     }
@@ -64,7 +87,7 @@ std::unique_ptr<StatementNode> Parser::parseStatement() {
     // --- NEW, SMARTER LOGIC ---
     // Check for the "identifier followed by a parenthesis" pattern
     // to disambiguate function calls from other potential statements.
-    if (check(TokenType::IDENTIFIER) && m_tokens[m_current + 1].type == TokenType::LEFT_PAREN) {
+    if (check(TokenType::IDENTIFIER) && peekNext().type == TokenType::LEFT_PAREN) {
         // This is a function call that is being used as a standalone statement
         // (e.g., `print(x);`). Its value is discarded.
 
@@ -73,180 +96,191 @@ std::unique_ptr<StatementNode> Parser::parseStatement() {
         return parseFunctionCallStatement();
     }
 
-    // If you were to add assignment statements like `x = 5;`, you would add another check here:
-    // if (check(TokenType::IDENTIFIER) && m_tokens[m_current + 1].type == TokenType::EQUAL) {
-    //     return parseAssignmentStatement();
-    // }
+    // An identifier followed by '=' assigns a new value to a variable (`x = x + 1;`).
+    if (check(TokenType::IDENTIFIER) && peekNext().type == TokenType::EQUAL) {
+        return parseAssignmentStatement();
+    }
 
     // If we get here, we have a token we don't know how to start a statement with.
-    std::cerr << "Parse Error: Invalid start of a statement. Found token '" << peek().value << "'\n";
-    return nullptr;
+    error(peek(), "Invalid start of a statement. Found token '" + std::string(peek().text(m_source)) + "'");
+    return kNoNode;
 }
 
 // Add this new function to parser.cpp
-std::unique_ptr<StatementNode> Parser::parseReturnStatement() {
+NodeIndex Parser::parseReturnStatement() {
     // 1. Consume the 'return' keyword
-    if (!consume(TokenType::RETURN, "Expect 'return' keyword.")) return nullptr;
-
-    // 2. Create the AST node
-    auto returnNode = std::make_unique<ReturnStatementNode>();
+    if (!consume(TokenType::RETURN, "Expect 'return' keyword.")) return kNoNode;
+    TokenIndex keyword = storePrevious();
 
-    // 3. Parse the expression that comes after 'return'
-    returnNode->returnValue = parseExpression();
-    if (!returnNode->returnValue) {
+    // 2. Parse the expression that comes after 'return'
+    NodeIndex returnValue = parseExpression();
+    if (returnValue == kNoNode) {
         // Error already printed by parseExpression
-        return nullptr;
+        return kNoNode;
     }
 
-    // 4. Consume the trailing semicolon
-    if (!consume(TokenType::SEMICOLON, "Expect ';' after return value.")) return nullptr;
+    // 3. Consume the trailing semicolon
+    if (!consume(TokenType::SEMICOLON, "Expect ';' after return value.")) return kNoNode;
 
-    return returnNode;
+    // 4. Create the AST node
+    return m_ast->addNode(NodeKind::ReturnStatement, keyword, returnValue);
 }
 
-std::unique_ptr<StatementNode> Parser::parseAutoStatement() {
+NodeIndex Parser::parseAutoStatement() {
     // 1. Consume the 'auto' keyword. We already know it's there from parseStatement.
     consume(TokenType::AUTO, "Expect 'auto' keyword."); // This just advances the token stream
 
-    // 2. Create the AST node to hold the data
-    auto autoNode = std::make_unique<AutoStatementNode>();
+    // 2. Parse the variable name (it must be an identifier)
+    if (!consume(TokenType::IDENTIFIER, "Expect variable name after 'auto'.")) return kNoNode;
+    TokenIndex name = storePrevious(); // the token we just consumed
 
-    // 3. Parse the variable name (it must be an identifier)
-    if (!consume(TokenType::IDENTIFIER, "Expect variable name after 'auto'.")) return nullptr;
-    autoNode->name = previous(); // 'previous()' gives us the token we just consumed
+    // 3. Parse the equals sign. This was the part you knew was missing!
+    if (!consume(TokenType::EQUAL, "Expect '=' after variable name.")) return kNoNode;
 
-    // 4. Parse the equals sign. This was the part you knew was missing!
-    if (!consume(TokenType::EQUAL, "Expect '=' after variable name.")) return nullptr;
+    // 4. Parse the initializer expression
+    NodeIndex initializer = parseExpression();
+    if (initializer == kNoNode) return kNoNode; // Check for parsing errors in the expression
 
-    // 5. Parse the initializer expression
-    autoNode->initializer = parseExpression();
-    if (!autoNode->initializer) return nullptr; // Check for parsing errors in the expression
+    // 5. Parse the final semicolon
+    if (!consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.")) return kNoNode;
 
-    // 6. Parse the final semicolon
-    if (!consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.")) return nullptr;
+    // 6. Success! Add the completed node to the tree.
+    return m_ast->addNode(NodeKind::AutoStatement, name, initializer);
+}
+
+NodeIndex Parser::parseAssignmentStatement() {
+    // 1. The variable name; parseStatement already saw it and the '='.
+    if (!consume(TokenType::IDENTIFIER, "Expect variable name.")) return kNoNode;
+    TokenIndex name = storePrevious();
+    if (!consume(TokenType::EQUAL, "Expect '=' after variable name.")) return kNoNode;
+
+    // 2. The new value, and the semicolon.
+    NodeIndex value = parseExpression();
+    if (value == kNoNode) return kNoNode;
+    if (!consume(TokenType::SEMICOLON, "Expect ';' after assignment.")) return kNoNode;
 
-    // 7. Success! Return the completed AST node.
-    return autoNode;
+    return m_ast->addNode(NodeKind::AssignmentStatement, name, value);
 }
 
-std::unique_ptr<FunctionCallStatementNode> Parser::parseFunctionCallStatement() {
-    auto funcCall = std::make_unique<FunctionCallStatementNode>();
-    if (!consume(TokenType::IDENTIFIER, "Expect function name for call.")) return nullptr;
-    funcCall->functionName = previous();
-    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after function name.")) return nullptr;
+NodeIndex Parser::parseFunctionCallStatement() {
+    if (!consume(TokenType::IDENTIFIER, "Expect function name for call.")) return kNoNode;
+    TokenIndex functionName = storePrevious();
+    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after function name.")) return kNoNode;
 
+    std::vector<NodeIndex> arguments;
     if (!check(TokenType::RIGHT_PAREN)) {
         do {
-            auto arg = parseExpression();
-            if (!arg) return nullptr;
-            funcCall->arguments.push_back(std::move(arg));
+            NodeIndex arg = parseExpression();
+            if (arg == kNoNode) return kNoNode;
+            arguments.push_back(arg);
         } while (consume(TokenType::COMMA, ""));
     }
 
-    if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.")) return nullptr;
-    if (!consume(TokenType::SEMICOLON, "Expect ';' after statement.")) return nullptr;
-    return funcCall;
+    if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.")) return kNoNode;
+    if (!consume(TokenType::SEMICOLON, "Expect ';' after statement.")) return kNoNode;
+    return m_ast->addCall(NodeKind::FunctionCallStatement, functionName, arguments);
 }
 
 // Add this to parser.cpp
-std::unique_ptr<ExpressionNode> Parser::parseFunctionCallExpression() {
-    // Create the AST Node (you'll need to define FunctionCallExprNode in ast.hpp)
-    auto funcCall = std::make_unique<FunctionCallExpressionNode>();
-
+NodeIndex Parser::parseFunctionCallExpression() {
     // The logic is the same as parseFunctionCallStatement, but without the trailing semicolon.
-    if (!consume(TokenType::IDENTIFIER, "Expect function name for call.")) return nullptr;
-    funcCall->functionName = previous();
+    if (!consume(TokenType::IDENTIFIER, "Expect function name for call.")) return kNoNode;
+    TokenIndex functionName = storePrevious();
 
-    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after function name.")) return nullptr;
+    if (!consume(TokenType::LEFT_PAREN, "Expect '(' after function name.")) return kNoNode;
 
+    std::vector<NodeIndex> arguments;
     if (!check(TokenType::RIGHT_PAREN)) {
         do {
-            auto arg = parseExpression();
-            if (!arg) return nullptr;
-            funcCall->arguments.push_back(std::move(arg));
+            NodeIndex arg = parseExpression();
+            if (arg == kNoNode) return kNoNode;
+            arguments.push_back(arg);
         } while (consume(TokenType::COMMA, ""));
     }
 
-    if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.")) return nullptr;
+    if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.")) return kNoNode;
 
-    return funcCall;
+    return m_ast->addCall(NodeKind::FunctionCallExpression, functionName, arguments);
 }
 
-std::unique_ptr<ExpressionNode> Parser::parseExpression() { return parseTerm(); }
+NodeIndex Parser::parseExpression() { return parseTerm(); }
 
-std::unique_ptr<ExpressionNode> Parser::parseTerm() {
-    auto left = parseFactor();
+NodeIndex Parser::parseTerm() {
+    NodeIndex left = parseFactor();
     while (check(TokenType::PLUS) || check(TokenType::MINUS)) {
-        Token op = advance();
-        auto right = parseFactor();
-        if (!left || !right) return nullptr;
-        auto new_left = std::make_unique<BinaryOpNode>();
-        new_left->left = std::move(left);
-        new_left->op = op;
-        new_left->right = std::move(right);
-        left = std::move(new_left);
+        advance();
+        TokenIndex op = storePrevious();
+        NodeIndex right = parseFactor();
+        if (left == kNoNode || right == kNoNode) return kNoNode;
+        left = m_ast->addNode(NodeKind::BinaryOp, op, left, right);
     }
     return left;
 }
 
-std::unique_ptr<ExpressionNode> Parser::parseFactor() {
-    auto left = parsePrimary();
+NodeIndex Parser::parseFactor() {
+    NodeIndex left = parsePrimary();
     while (check(TokenType::STAR) || check(TokenType::SLASH)) {
-        Token op = advance();
-        auto right = parsePrimary();
-        if (!left || !right) return nullptr;
-        auto new_left = std::make_unique<BinaryOpNode>();
-        new_left->left = std::move(left);
-        new_left->op = op;
-        new_left->right = std::move(right);
-        left = std::move(new_left);
+        advance();
+        TokenIndex op = storePrevious();
+        NodeIndex right = parsePrimary();
+        if (left == kNoNode || right == kNoNode) return kNoNode;
+        left = m_ast->addNode(NodeKind::BinaryOp, op, left, right);
     }
     return left;
 }
 
-std::unique_ptr<ExpressionNode> Parser::parsePrimary() {
+NodeIndex Parser::parsePrimary() {
     if (check(TokenType::NUMBER_LITERAL)) {
-        auto numNode = std::make_unique<NumberLiteralNode>();
-        numNode->value = advance();
-        return numNode;
+        advance();
+        return m_ast->addNode(NodeKind::NumberLiteral, storePrevious());
     }
     if (check(TokenType::STRING_LITERAL)) {
-        auto strNode = std::make_unique<StringLiteralNode>();
-        strNode->value = advance();
-        return strNode;
+        advance();
+        return m_ast->addNode(NodeKind::StringLiteral, storePrevious());
     }
 
     // --- THIS IS THE KEY FIX ---
     if (check(TokenType::IDENTIFIER)) {
         // We see an identifier. Is it a variable OR a function call?
         // Let's PEEK ahead one token. We don't consume it yet.
-        if (m_tokens[m_current + 1].type == TokenType::LEFT_PAREN) {
+        if (peekNext().type == TokenType::LEFT_PAREN) {
             // It's an identifier followed by '(', so it MUST be a function call.
-            return parseFunctionCallExpression(); // We need to write this function!
+            return parseFunctionCallExpression();
         } else {
             // It's just a variable name.
-            auto varNode = std::make_unique<VariableNode>();
-            varNode->name = advance();
-            return varNode;
+            advance();
+            return m_ast->addNode(NodeKind::Variable, storePrevious());
         }
     }
 
     if (check(TokenType::LEFT_PAREN)) {
         advance();
-        auto expr = parseExpression();
-        if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.")) return nullptr;
+        NodeIndex expr = parseExpression();
+        if (!consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.")) return kNoNode;
         return expr;
     }
 
-    std::cerr << "Parse Error: Expected an expression..." << std::endl;
-    return nullptr;
+    error(peek(), "Expected an expression.");
+    return kNoNode;
+}
+
+const Token& Parser::tokenAt(size_t position) {
+    // The window only reaches one token back from the current one, so we
+    // never need to look more than kWindowSize - 2 tokens ahead.
+    while (m_fetched <= position) {
+        m_window[m_fetched % kWindowSize] = m_lexer.getNextToken();
+        m_fetched++;
+    }
+    return m_window[position % kWindowSize];
 }
 
-Token Parser::peek() { return m_tokens[m_current]; }
-Token Parser::previous() { return m_tokens[m_current - 1]; }
+const Token& Parser::peek() { return tokenAt(m_current); }
+const Token& Parser::peekNext() { return isAtEnd() ? peek() : tokenAt(m_current + 1); }
+const Token& Parser::previous() { return tokenAt(m_current - 1); }
 bool Parser::isAtEnd() { return peek().type == TokenType::END_OF_FILE; }
 bool Parser::check(TokenType type) { if(isAtEnd()) return false; return peek().type == type; }
-Token Parser::advance() { if (!isAtEnd()) m_current++; return previous(); }
+const Token& Parser::advance() { if (!isAtEnd()) m_current++; return previous(); }
+TokenIndex Parser::storePrevious() { return m_ast->addToken(previous()); }
 
 bool Parser::consume(TokenType type, const std::string& message) {
     if (check(type)) {
@@ -254,8 +288,22 @@ bool Parser::consume(TokenType type, const std::string& message) {
         return true;
     }
     if (!message.empty()) {
-        std::cerr << "Parse error: " << message << std::endl;
+        error(peek(), message);
     }
     return false;
 }
 
+void Parser::error(const Token& token, const std::string& message) {
+    m_diagnostics << "Parse error at " << token.line << ":" << token.column << ": " << message;
+    if (token.type == TokenType::UNKNOWN) {
+        // The lexer hands us anything it didn't recognize as an UNKNOWN token.
+        std::string_view text = token.text(m_source);
+        if (!text.empty() && text[0] == '"') {
+            m_diagnostics << " (unterminated string)";
+        } else {
+            m_diagnostics << " (unexpected character '" << text << "')";
+        }
+    }
+    m_diagnostics << std::endl;
+}
+
@@ -1,38 +1,69 @@
 #pragma once
 #include "token.hpp"
+#include "lexer.hpp"
 #include "ast.hpp"
 #include <vector>
 #include <memory>
+#include <ostream>
+#include <string_view>
 
 class Parser {
 public:
-    Parser(const std::vector<Token>& tokens);
-    std::unique_ptr<ProgramNode> parse();
+    // The parser pulls tokens from the lexer one at a time as it needs them,
+    // so the token stream is never stored as a whole. Errors are written to
+    // `diagnostics`.
+    Parser(Lexer& lexer, std::ostream& diagnostics);
+
+    // Builds the whole tree into a fresh Ast. Returns nullptr on a parse error.
+    std::unique_ptr<Ast> parse();
 
 private:
-    std::vector<Token> m_tokens;
-    size_t m_current = 0;
+    Lexer& m_lexer;
+    std::string_view m_source;
+    std::ostream& m_diagnostics;
+
+    // --- Lookahead Window ---
+    // A tiny ring buffer over the token stream. It holds the previous token,
+    // the current one and the lookahead; tokens are addressed by their position
+    // in the whole stream and wrap around in the buffer.
+    static constexpr size_t kWindowSize = 4; // Must be a power of two
+    Token m_window[kWindowSize];
+    size_t m_current = 0; // Stream position of the current token
+    size_t m_fetched = 0; // Number of tokens pulled from the lexer so far
+
+    // Returns the token at stream position `position`, lexing up to it if needed.
+    const Token& tokenAt(size_t position);
+    std::unique_ptr<Ast> m_ast; // The tree being built
+
+    // Copies the most recently consumed token into the Ast and returns its index.
+    TokenIndex storePrevious();
 
     // Helper methods
-    Token peek();
-    Token previous();
-    Token advance();
+    const Token& peek();
+    const Token& peekNext(); // One token past peek()
+    const Token& previous();
+    const Token& advance();
     bool isAtEnd();
     bool check(TokenType type);
     bool consume(TokenType type, const std::string& message);
 
-    // Parsing methods
-    std::unique_ptr<FunctionDefinitionNode> parseFunctionDefinition();
-    std::unique_ptr<StatementNode> parseStatement();
-    std::unique_ptr<StatementNode> parseReturnStatement();
-    std::unique_ptr<StatementNode> parseAutoStatement();
-    std::unique_ptr<FunctionCallStatementNode> parseFunctionCallStatement();
-    std::unique_ptr<ExpressionNode> parseFunctionCallExpression();
+    // Prints "Parse error at line:column: message" for the given token.
+    void error(const Token& token, const std::string& message);
+
+    // Parsing methods. Each returns the index of the node it built,
+    // or kNoNode if there was an error (which has already been printed).
+    NodeIndex parseFunctionDefinition();
+    NodeIndex parseStatement();
+    NodeIndex parseReturnStatement();
+    NodeIndex parseAutoStatement();
+    NodeIndex parseAssignmentStatement();
+    NodeIndex parseFunctionCallStatement();
+    NodeIndex parseFunctionCallExpression();
 
     // --- Expression Parsing Hierarchy ---
-    std::unique_ptr<ExpressionNode> parseExpression(); // Entry Point
-    std::unique_ptr<ExpressionNode> parseTerm();       // Handles: + -
-    std::unique_ptr<ExpressionNode> parseFactor();     // Handles: * /
-    std::unique_ptr<ExpressionNode> parsePrimary();    // Handles: Literals, Grouping
-    std::unique_ptr<ParameterNode> parseParameter();
+    NodeIndex parseExpression(); // Entry Point
+    NodeIndex parseTerm();       // Handles: + -
+    NodeIndex parseFactor();     // Handles: * /
+    NodeIndex parsePrimary();    // Handles: Literals, Grouping
+    NodeIndex parseParameter();
 };
\ No newline at end of file
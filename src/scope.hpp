@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "interner.hpp"
+
+// A stack of nested scopes mapping Symbols to values of type T.
+//
+// Instead of one map per scope, every binding lives in a single flat stack and
+// a table indexed directly by Symbol points at the innermost binding of each
+// name. Lookups are one array access, declaring a name never searches, and
+// leaving a scope just pops its bindings and puts the shadowed ones back.
+template <typename T>
+class ScopedSymbolTable {
+public:
+    // Opens a new, innermost scope.
+    void pushScope() { m_scope_starts.push_back(m_bindings.size()); }
+
+    // Closes the innermost scope and forgets everything declared in it.
+    void popScope() {
+        size_t start = m_scope_starts.back();
+        m_scope_starts.pop_back();
+        while (m_bindings.size() > start) {
+            const Binding& binding = m_bindings.back();
+            m_innermost[binding.symbol] = binding.shadowed;
+            m_bindings.pop_back();
+        }
+    }
+
+    // Binds `symbol` in the innermost scope, hiding any outer binding of the same name.
+    void declare(Symbol symbol, T value) {
+        if (symbol >= m_innermost.size()) {
+            m_innermost.resize(symbol + 1, kUnbound);
+        }
+        m_bindings.push_back(Binding{symbol, value, m_innermost[symbol]});
+        m_innermost[symbol] = static_cast<uint32_t>(m_bindings.size() - 1);
+    }
+
+    // Returns the innermost binding of `symbol`, or nullptr if it isn't declared.
+    // Unlike std::map::operator[], a miss never inserts anything.
+    T* lookup(Symbol symbol) {
+        if (symbol >= m_innermost.size() || m_innermost[symbol] == kUnbound) {
+            return nullptr;
+        }
+        return &m_bindings[m_innermost[symbol]].value;
+    }
+
+private:
+    static constexpr uint32_t kUnbound = UINT32_MAX;
+
+    struct Binding {
+        Symbol symbol;
+        T value;
+        uint32_t shadowed; // The binding this one hides, or kUnbound
+    };
+
+    std::vector<Binding> m_bindings;
+    std::vector<size_t> m_scope_starts;
+    std::vector<uint32_t> m_innermost; // Symbol -> index into m_bindings
+};
@@ -0,0 +1,208 @@
+#include "server.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Requests and replies bigger than this are refused as garbage.
+static constexpr uint32_t kMaxMessageString = 1u << 30;
+
+// --- Socket Helpers ---
+static bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        p += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t got = ::recv(fd, p, size, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+static bool writeString(int fd, const std::string& text) {
+    uint32_t length = static_cast<uint32_t>(text.size());
+    return writeAll(fd, &length, sizeof(length)) && writeAll(fd, text.data(), text.size());
+}
+
+static bool readString(int fd, std::string& text) {
+    uint32_t length;
+    if (!readAll(fd, &length, sizeof(length)) || length > kMaxMessageString) return false;
+    text.resize(length);
+    return readAll(fd, text.data(), length);
+}
+
+// Fills in a Unix socket address. Returns false if the path is too long for one.
+static bool makeAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Connects to the socket at `path`. Returns -1 if nothing is listening there.
+static int connectTo(const std::string& path) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// --- Server ---
+// The socket file to remove when the server is stopped. A plain array, since
+// the signal handler may only make async-signal-safe calls.
+static char socketToRemove[sizeof(sockaddr_un::sun_path)];
+
+static void stopServer(int) {
+    ::unlink(socketToRemove);
+    ::_exit(0);
+}
+
+static void serveConnection(int fd, const CompileRequestHandler& handler) {
+    // 1. Read the request.
+    std::string directory;
+    uint32_t count = 0;
+    std::vector<std::string> arguments;
+    bool ok = readString(fd, directory) && readAll(fd, &count, sizeof(count)) && count < 65536;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        arguments.emplace_back();
+        ok = readString(fd, arguments.back());
+    }
+    if (!ok) {
+        ::close(fd); // Not one of our clients, or it went away
+        return;
+    }
+
+    // 2. Compile it, capturing everything that would have been printed.
+    std::ostringstream out, err;
+    int32_t exitCode = handler(arguments, directory, out, err);
+
+    // 3. Send back the result. If the client is gone there is nobody to tell.
+    writeAll(fd, &exitCode, sizeof(exitCode)) && writeString(fd, out.str()) && writeString(fd, err.str());
+    ::close(fd);
+}
+
+int runServer(const std::string& socketPath, const CompileRequestHandler& handler) {
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        std::cerr << "Error: Socket path '" << socketPath << "' is too long" << std::endl;
+        return 1;
+    }
+
+    // A socket file with nobody listening is left over from a server that
+    // was killed hard; one with a listener means we'd be the second server.
+    int existing = connectTo(socketPath);
+    if (existing >= 0) {
+        ::close(existing);
+        std::cerr << "Error: A compile server is already listening on '" << socketPath << "'" << std::endl;
+        return 1;
+    }
+    ::unlink(socketPath.c_str());
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "Error: Could not listen on '" << socketPath << "': " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::memcpy(socketToRemove, address.sun_path, sizeof(socketToRemove));
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    std::signal(SIGPIPE, SIG_IGN); // Clients that go away mid-reply
+
+    std::cout << "Compile server listening on '" << socketPath << "'" << std::endl;
+    for (;;) {
+        int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "Error: accept() failed: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        std::thread(serveConnection, fd, std::cref(handler)).detach();
+    }
+}
+
+// --- Client ---
+bool canForward(const CompileOptions& options) {
+    bool readsStdin = std::find(options.inputs.begin(), options.inputs.end(), "-") != options.inputs.end();
+    return !options.run && !options.timeReport && options.traceFile.empty() && !readsStdin &&
+           !options.inputs.empty() && options.serverSocket.empty();
+}
+
+bool forwardCommandLine(const CompileOptions& options, int argc, char** argv, int& exitCode) {
+    // The cache directory may have come from our environment, so it is passed
+    // along explicitly (ahead of the arguments, so that a --cache-dir among
+    // them still wins).
+    std::vector<std::string> arguments;
+    if (!options.cacheDir.empty()) {
+        arguments.push_back("--cache-dir=" + options.cacheDir);
+    }
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]).rfind("--connect=", 0) != 0) {
+            arguments.push_back(argv[i]);
+        }
+    }
+
+    const std::string& socketPath = options.connectSocket;
+    int fd = connectTo(socketPath);
+    if (fd < 0) {
+        return false;
+    }
+
+    char directory[4096];
+    if (!::getcwd(directory, sizeof(directory))) {
+        ::close(fd);
+        return false;
+    }
+
+    uint32_t count = static_cast<uint32_t>(arguments.size());
+    bool sent = writeString(fd, directory) && writeAll(fd, &count, sizeof(count));
+    for (size_t i = 0; sent && i < arguments.size(); i++) {
+        sent = writeString(fd, arguments[i]);
+    }
+
+    int32_t serverExitCode = 1;
+    std::string out, err;
+    bool received = sent && readAll(fd, &serverExitCode, sizeof(serverExitCode)) && readString(fd, out) &&
+                    readString(fd, err);
+    ::close(fd);
+
+    if (!received) {
+        // The server took the request, so compiling here could race with it.
+        std::cerr << "Error: Lost the connection to the compile server on '" << socketPath << "'" << std::endl;
+        exitCode = 1;
+        return true;
+    }
+
+    std::cerr << err << std::flush;
+    std::cout << out << std::flush;
+    exitCode = serverExitCode;
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "options.hpp"
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// --- Compile Server ---
+// `ac --server=<socket>` stays running and compiles on behalf of clients:
+// `ac --connect=<socket> ...`, any `ac` with $ATHERIA_SERVER set, or better
+// `ac_client`, which takes the same arguments as `ac` but doesn't link LLVM
+// at all (and runs `ac` itself when there is no server). A cold
+// `ac` spends most of a small compile before it gets to the file: loading and
+// relocating LLVM, running its static constructors, registering every target
+// and building a TargetMachine. The server pays for all of that once, and
+// keeps TargetMachines (see CodeGen) and the host CPU description warm
+// between requests. Each connection is handled on its own thread.
+//
+// One request per connection, in host byte order (it's a local socket):
+//   client -> server   string directory, uint32 count, `count` strings (the arguments)
+//   server -> client   int32 exit code, string stdout, string stderr
+// where a string is a uint32 length followed by that many bytes.
+
+// Compiles one request. `arguments` are as given to `ac` (without argv[0]);
+// relative paths in them are relative to `directory`.
+using CompileRequestHandler = std::function<int(const std::vector<std::string>& arguments, const std::string& directory,
+                                                std::ostream& out, std::ostream& err)>;
+
+// Serves requests until the process is killed (the socket is removed on
+// SIGINT and SIGTERM). Only returns, with the exit code, if it can't start.
+int runServer(const std::string& socketPath, const CompileRequestHandler& handler);
+
+// Whether a compile server could do this command. Programs run in the JIT,
+// reading stdin and the process-wide timers have to stay in the client.
+bool canForward(const CompileOptions& options);
+
+// Has the server at options.connectSocket compile the command line `argv`
+// (parsed into `options`) from the current directory, and prints what it
+// printed. Returns false if no server is listening, so the caller can compile
+// by itself; otherwise sets `exitCode`.
+bool forwardCommandLine(const CompileOptions& options, int argc, char** argv, int& exitCode);
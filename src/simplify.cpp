@@ -0,0 +1,269 @@
+#include "simplify.hpp"
+#include "consteval.hpp"
+#include "interner.hpp"
+#include "scope.hpp"
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// What the simplifier knows about an expression, or about the value a variable holds.
+struct Facts {
+    bool integer = false;  // Known to be an int32_t
+    bool constant = false; // ...with this value
+    int32_t value = 0;
+    bool pure = true;      // Evaluating it does nothing but compute the value (no calls)
+};
+
+// log2 of `value` if it is a power of two greater than one, otherwise 0.
+uint32_t powerOfTwo(int32_t value) {
+    if (value <= 1 || (value & (value - 1)) != 0) return 0;
+    uint32_t shift = 0;
+    while ((1 << shift) != value) shift++;
+    return shift;
+}
+
+class Simplifier {
+public:
+    Simplifier(Ast& ast, std::ostream& diagnostics, ConstexprLimits limits)
+        : m_ast(ast), m_diagnostics(diagnostics), m_interpreter(ast, diagnostics, limits) {}
+
+    bool run() {
+        ProgramNode program = m_ast.program(m_ast.root());
+
+        // Calls are int32_t only if the callee is defined to return one.
+        for (NodeIndex index : program.functions) {
+            FunctionDefinitionNode function = m_ast.function(index);
+            if (function.returnType.symbol == sym::Int32) {
+                m_integer_functions.insert(function.functionName.symbol);
+            }
+        }
+
+        // Constexpr functions become callable at compile time where they are
+        // defined, like they become callable at all in CodeGen.
+        for (NodeIndex index : program.functions) {
+            FunctionDefinitionNode function = m_ast.function(index);
+            if (function.isConstexpr()) {
+                m_interpreter.define(index);
+            }
+            simplifyFunction(function);
+        }
+        return m_ok && m_interpreter.ok();
+    }
+
+private:
+    void simplifyFunction(const FunctionDefinitionNode& function) {
+        // 1. Variables that are assigned to anywhere in the body never count as constants.
+        m_reassigned.clear();
+        for (NodeIndex statement : function.body) {
+            if (m_ast.kind(statement) == NodeKind::AssignmentStatement) {
+                m_reassigned.insert(m_ast.assignment(statement).name.symbol);
+            }
+        }
+
+        // 2. Walk the statements in order, learning about variables as they are declared.
+        m_variables.pushScope();
+        for (NodeIndex index : function.parameters) {
+            ParameterNode parameter = m_ast.parameter(index);
+            Facts facts;
+            facts.integer = parameter.type.symbol == sym::Int32;
+            m_variables.declare(parameter.name.symbol, facts);
+        }
+        for (NodeIndex statement : function.body) {
+            switch (m_ast.kind(statement)) {
+                case NodeKind::FunctionCallStatement:
+                    for (NodeIndex argument : m_ast.call(statement).arguments) simplifyExpression(argument);
+                    break;
+                case NodeKind::ReturnStatement:
+                    simplifyExpression(m_ast.returnStatement(statement).returnValue);
+                    break;
+                case NodeKind::AutoStatement: {
+                    AutoStatementNode node = m_ast.autoStatement(statement);
+                    Facts facts = simplifyExpression(node.initializer);
+                    facts.constant = facts.constant && !m_reassigned.count(node.name.symbol);
+                    facts.pure = true; // Reading the variable has no effects, whatever its initializer had
+                    m_variables.declare(node.name.symbol, facts);
+                    break;
+                }
+                case NodeKind::AssignmentStatement:
+                    simplifyExpression(m_ast.assignment(statement).value);
+                    break;
+                default:
+                    break;
+            }
+        }
+        m_variables.popScope();
+    }
+
+    Facts simplifyExpression(NodeIndex index) {
+        Facts facts;
+        switch (m_ast.kind(index)) {
+            case NodeKind::NumberLiteral: {
+                // Literals that don't fit are left for the code generator to report.
+                facts.integer = true;
+                std::string_view digits = m_ast.text(m_ast.leafToken(index));
+                int32_t value = 0;
+                auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+                if (ec == std::errc() && end == digits.data() + digits.size()) {
+                    makeConstant(index, value, facts);
+                }
+                return facts;
+            }
+
+            case NodeKind::Constant:
+                facts.integer = true;
+                facts.constant = true;
+                facts.value = m_ast.constant(index);
+                return facts;
+
+            case NodeKind::Variable: {
+                // Unknown variables are the code generator's to report.
+                Facts* variable = m_variables.lookup(m_ast.leafToken(index).symbol);
+                if (!variable) return facts;
+                facts = *variable;
+                if (facts.constant) {
+                    makeConstant(index, facts.value, facts);
+                }
+                return facts;
+            }
+
+            case NodeKind::FunctionCallExpression: {
+                FunctionCallNode call = m_ast.call(index);
+                std::vector<int32_t> arguments;
+                bool constantArguments = true;
+                for (NodeIndex argument : call.arguments) {
+                    Facts argumentFacts = simplifyExpression(argument);
+                    constantArguments = constantArguments && argumentFacts.constant;
+                    arguments.push_back(argumentFacts.value);
+                }
+                facts.integer = m_integer_functions.count(call.functionName.symbol) != 0;
+                facts.pure = false;
+
+                // A constexpr function called with constants is run right here.
+                if (constantArguments && m_interpreter.isDefined(call.functionName.symbol)) {
+                    if (std::optional<int32_t> value = m_interpreter.call(call.functionName, arguments)) {
+                        makeConstant(index, *value, facts);
+                    }
+                }
+                return facts;
+            }
+
+            case NodeKind::BinaryOp:
+                return simplifyBinaryOp(index);
+
+            default:
+                return facts; // String literals
+        }
+    }
+
+    Facts simplifyBinaryOp(NodeIndex index) {
+        BinaryOpNode node = m_ast.binaryOp(index);
+        Facts left = simplifyExpression(node.left);
+        Facts right = simplifyExpression(node.right);
+
+        Facts facts;
+        facts.integer = left.integer && right.integer;
+        facts.pure = left.pure && right.pure;
+        if (!facts.integer) {
+            return facts; // Strings (an error) or a type we don't know: leave it alone
+        }
+        TokenType op = node.op.type;
+
+        // 1. Division by a constant that makes it undefined, folded or not.
+        if (op == TokenType::SLASH && right.constant) {
+            if (right.value == 0) {
+                error(node.op, "Division by zero");
+                return facts;
+            }
+            if (right.value == -1 && left.constant && left.value == INT32_MIN) {
+                error(node.op, "Division overflows int32_t");
+                return facts;
+            }
+        }
+
+        // 2. Both sides known: fold. The arithmetic is done unsigned so that
+        //    it wraps around like the generated code does.
+        if (left.constant && right.constant) {
+            uint32_t a = static_cast<uint32_t>(left.value), b = static_cast<uint32_t>(right.value);
+            int32_t value;
+            switch (op) {
+                case TokenType::PLUS: value = static_cast<int32_t>(a + b); break;
+                case TokenType::MINUS: value = static_cast<int32_t>(a - b); break;
+                case TokenType::STAR: value = static_cast<int32_t>(a * b); break;
+                case TokenType::SLASH: value = left.value / right.value; break;
+                default: return facts;
+            }
+            makeConstant(index, value, facts);
+            return facts;
+        }
+
+        // 3. Identities with a constant on the right...
+        if (right.constant) {
+            if (((op == TokenType::PLUS || op == TokenType::MINUS) && right.value == 0) ||
+                ((op == TokenType::STAR || op == TokenType::SLASH) && right.value == 1)) {
+                m_ast.replaceNode(index, m_ast.node(node.left));
+                return left;
+            }
+            if (op == TokenType::STAR && right.value == 0 && left.pure) {
+                makeConstant(index, 0, facts);
+                return facts;
+            }
+            if (uint32_t shift = powerOfTwo(right.value)) {
+                if (op == TokenType::STAR) {
+                    m_ast.replaceNode(index, AstNode{NodeKind::ShiftLeft, m_ast.node(index).token, node.left, shift});
+                } else if (op == TokenType::SLASH) {
+                    m_ast.replaceNode(index, AstNode{NodeKind::DivideByPowerOfTwo, m_ast.node(index).token, node.left, shift});
+                }
+            }
+            return facts;
+        }
+
+        // 4. ...and on the left.
+        if (left.constant) {
+            if ((op == TokenType::PLUS && left.value == 0) || (op == TokenType::STAR && left.value == 1)) {
+                m_ast.replaceNode(index, m_ast.node(node.right));
+                return right;
+            }
+            if (op == TokenType::STAR && left.value == 0 && right.pure) {
+                makeConstant(index, 0, facts);
+                return facts;
+            }
+            if (uint32_t shift = powerOfTwo(left.value); shift && op == TokenType::STAR) {
+                m_ast.replaceNode(index, AstNode{NodeKind::ShiftLeft, m_ast.node(index).token, node.right, shift});
+            }
+        }
+        return facts;
+    }
+
+    // Turns the node into a Constant (keeping its token for diagnostics) and records the value in `facts`.
+    void makeConstant(NodeIndex index, int32_t value, Facts& facts) {
+        m_ast.replaceNode(index, AstNode{NodeKind::Constant, m_ast.node(index).token, static_cast<uint32_t>(value), 0});
+        facts.integer = true;
+        facts.constant = true;
+        facts.value = value;
+        facts.pure = true;
+    }
+
+    void error(const Token& token, const char* message) {
+        m_diagnostics << "Error at " << token.line << ":" << token.column << ": " << message << "\n";
+        m_ok = false;
+    }
+
+    Ast& m_ast;
+    std::ostream& m_diagnostics;
+    bool m_ok = true;
+
+    std::unordered_set<Symbol> m_integer_functions; // Functions that return int32_t
+    std::unordered_set<Symbol> m_reassigned;        // Variables the current function assigns to
+    ScopedSymbolTable<Facts> m_variables;
+    ConstexprInterpreter m_interpreter;
+};
+
+} // namespace
+
+bool simplifyAst(Ast& ast, std::ostream& diagnostics, ConstexprLimits limits) {
+    return Simplifier(ast, diagnostics, limits).run();
+}
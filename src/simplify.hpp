@@ -0,0 +1,30 @@
+#pragma once
+#include "ast.hpp"
+#include "consteval.hpp"
+#include <ostream>
+
+// --- Simplification ---
+// A pass over the tree between parsing and code generation, so that the
+// code generator (and at -O0, the generated code) doesn't spend time on
+// arithmetic whose result is already known:
+//
+//   - operations on constants are folded, with the same int32_t wraparound
+//     as the generated code;
+//   - `auto` variables that are initialized with a constant and never
+//     assigned to are replaced by the constant where they are read;
+//   - x + 0, x - 0, 0 + x, x * 1, 1 * x and x / 1 become x, and x * 0 and
+//     0 * x become 0 when x contains no calls;
+//   - multiplication by a power of two becomes a shift, and division by one
+//     of them becomes the shift-and-round sequence (see DivideByPowerOfTwo);
+//   - calls to constexpr functions with constant arguments are evaluated
+//     (see consteval.hpp), within `limits`.
+//
+// Nodes are rewritten in place, so the tree only ever gets smaller.
+// Identities are only applied when the other operand is known to be an
+// int32_t, so that `"text" * 1` still fails the way it did.
+//
+// Dividing by a constant zero, or INT32_MIN by -1, is an error. It is
+// reported even where an identity would have removed the division. So are
+// constexpr functions that break the rules and evaluations that fail.
+// Returns false after printing the errors.
+bool simplifyAst(Ast& ast, std::ostream& diagnostics, ConstexprLimits limits = {});
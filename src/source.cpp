@@ -0,0 +1,87 @@
+#include "source.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Token offsets are 32-bit, so that's as big as a single input can get.
+static constexpr uint64_t kMaxSourceSize = UINT32_MAX;
+
+std::unique_ptr<SourceBuffer> SourceBuffer::open(const std::string& path, std::ostream& diagnostics) {
+    std::unique_ptr<SourceBuffer> buffer(new SourceBuffer(path));
+
+    bool isStdin = path == "-";
+    int fd = isStdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        diagnostics << "Error: Could not open file '" << path << "': " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    struct stat info;
+    bool ok;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        if (static_cast<uint64_t>(info.st_size) > kMaxSourceSize) {
+            diagnostics << "Error: '" << path << "' is too large (the limit is 4 GB)" << std::endl;
+            ok = false;
+        } else {
+            // Fall back to reading if the mapping fails for some reason.
+            ok = buffer->map(fd, static_cast<size_t>(info.st_size)) || buffer->read(fd, diagnostics);
+        }
+    } else {
+        // Pipes, terminals and the like. Empty regular files end up here too,
+        // since a zero-length mapping isn't allowed.
+        ok = buffer->read(fd, diagnostics);
+    }
+
+    if (!isStdin) ::close(fd);
+    if (!ok) return nullptr;
+    return buffer;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (m_mapping) {
+        munmap(m_mapping, m_size);
+    }
+}
+
+bool SourceBuffer::map(int fd, size_t size) {
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    // The lexer makes a single front-to-back pass, so let the kernel read ahead.
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    m_mapping = mapping;
+    m_data = static_cast<const char*>(mapping);
+    m_size = size;
+    return true;
+}
+
+bool SourceBuffer::read(int fd, std::ostream& diagnostics) {
+    char chunk[64 * 1024];
+    while (true) {
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            diagnostics << "Error: Could not read '" << m_name << "': " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        m_storage.append(chunk, static_cast<size_t>(n));
+        if (m_storage.size() > kMaxSourceSize) {
+            diagnostics << "Error: '" << m_name << "' is too large (the limit is 4 GB)" << std::endl;
+            return false;
+        }
+    }
+
+    m_data = m_storage.data();
+    m_size = m_storage.size();
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// The contents of one input file, ready to be lexed in place.
+//
+// Regular files are memory-mapped, so even very large inputs are never copied:
+// the lexer scans the page cache directly. Pipes, terminals and stdin ("-")
+// can't be mapped and are read into memory instead. Each input file of a
+// compilation gets its own SourceBuffer.
+class SourceBuffer {
+public:
+    // Returns nullptr (after printing why to `diagnostics`) if the file can't be read.
+    static std::unique_ptr<SourceBuffer> open(const std::string& path, std::ostream& diagnostics);
+
+    ~SourceBuffer();
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    std::string_view text() const { return std::string_view(m_data, m_size); }
+    const std::string& name() const { return m_name; }
+    bool isMapped() const { return m_mapping != nullptr; }
+
+private:
+    explicit SourceBuffer(std::string name) : m_name(std::move(name)) {}
+
+    bool map(int fd, size_t size);
+    bool read(int fd, std::ostream& diagnostics);
+
+    std::string m_name;
+    const char* m_data = "";
+    size_t m_size = 0;
+
+    void* m_mapping = nullptr; // Set when the file is memory-mapped...
+    std::string m_storage;     // ...otherwise the contents live here
+};
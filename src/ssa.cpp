@@ -0,0 +1,106 @@
+#include "ssa.hpp"
+
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+
+void SsaBuilder::writeVariable(SsaVariable variable, llvm::BasicBlock* block, llvm::Value* value) {
+    m_definitions[{block, variable}] = value;
+}
+
+llvm::Value* SsaBuilder::readVariable(SsaVariable variable, llvm::Type* type, llvm::BasicBlock* block) {
+    // The common case: the block assigned the variable itself.
+    auto it = m_definitions.find({block, variable});
+    if (it != m_definitions.end()) {
+        return it->second;
+    }
+    return readVariableRecursive(variable, type, block);
+}
+
+// Phis go at the top of the block, ahead of anything already generated in it.
+static llvm::PHINode* createPhi(llvm::Type* type, llvm::BasicBlock* block) {
+    if (block->empty()) {
+        return llvm::PHINode::Create(type, 0, "", block);
+    }
+    return llvm::PHINode::Create(type, 0, "", &block->front());
+}
+
+llvm::Value* SsaBuilder::readVariableRecursive(SsaVariable variable, llvm::Type* type, llvm::BasicBlock* block) {
+    llvm::Value* value;
+    if (!m_sealed.contains(block)) {
+        // 1. Not all predecessors are known yet: a placeholder, completed by sealBlock.
+        llvm::PHINode* phi = createPhi(type, block);
+        m_incomplete_phis[block].push_back({variable, phi});
+        value = phi;
+    } else if (llvm::BasicBlock* predecessor = block->getSinglePredecessor()) {
+        // 2. Only one way in: no phi needed.
+        value = readVariable(variable, type, predecessor);
+    } else if (llvm::pred_empty(block)) {
+        // 3. The entry block (or unreachable code), and nothing assigned it.
+        value = llvm::PoisonValue::get(type);
+    } else {
+        // 4. A join. The phi is recorded before the predecessors are looked
+        //    at, so that a loop back into this block finds it and stops.
+        llvm::PHINode* phi = createPhi(type, block);
+        writeVariable(variable, block, phi);
+        value = addPhiOperands(variable, phi);
+    }
+    writeVariable(variable, block, value);
+    return value;
+}
+
+llvm::Value* SsaBuilder::addPhiOperands(SsaVariable variable, llvm::PHINode* phi) {
+    for (llvm::BasicBlock* predecessor : llvm::predecessors(phi->getParent())) {
+        phi->addIncoming(readVariable(variable, phi->getType(), predecessor), predecessor);
+    }
+    return tryRemoveTrivialPhi(phi);
+}
+
+llvm::Value* SsaBuilder::tryRemoveTrivialPhi(llvm::PHINode* phi) {
+    // 1. A phi is trivial if it merges one value (and perhaps itself).
+    llvm::Value* same = nullptr;
+    for (llvm::Value* operand : phi->incoming_values()) {
+        if (operand == same || operand == phi) continue;
+        if (same) return phi; // Merges at least two values
+        same = operand;
+    }
+    if (!same) {
+        same = llvm::PoisonValue::get(phi->getType()); // Only reachable from itself
+    }
+
+    // 2. Replace it everywhere. Phis that used it may have become trivial in
+    //    turn; the handles follow values that are replaced in the meantime.
+    llvm::WeakTrackingVH result = same;
+    llvm::SmallVector<llvm::WeakTrackingVH, 8> phiUsers;
+    for (llvm::User* user : phi->users()) {
+        if (user != phi && llvm::isa<llvm::PHINode>(user)) {
+            phiUsers.push_back(user);
+        }
+    }
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+
+    for (llvm::WeakTrackingVH& user : phiUsers) {
+        if (auto* userPhi = llvm::dyn_cast_or_null<llvm::PHINode>(static_cast<llvm::Value*>(user))) {
+            tryRemoveTrivialPhi(userPhi);
+        }
+    }
+    return result;
+}
+
+void SsaBuilder::sealBlock(llvm::BasicBlock* block) {
+    auto it = m_incomplete_phis.find(block);
+    if (it != m_incomplete_phis.end()) {
+        auto phis = std::move(it->second);
+        m_incomplete_phis.erase(it);
+        for (auto& [variable, phi] : phis) {
+            addPhiOperands(variable, phi);
+        }
+    }
+    m_sealed.insert(block);
+}
+
+void SsaBuilder::clear() {
+    m_definitions.clear();
+    m_sealed.clear();
+    m_incomplete_phis.clear();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/ValueHandle.h"
+
+// --- SSA Construction ---
+// Builds SSA form while the IR is generated, following Braun et al., "Simple
+// and Efficient Construction of Static Single Assignment Form" (CC 2013).
+// Instead of giving every variable a stack slot and leaving it to mem2reg,
+// CodeGen records which value a variable holds at the end of each block, and
+// a read looks that up, walking back through the predecessors (and inserting
+// a phi where several of them meet) only when the block doesn't assign the
+// variable itself. Phis that turn out to merge a single value are removed on
+// the spot, so the IR comes out as if mem2reg had already run.
+//
+// A block is "sealed" once all of its predecessors exist. Reads in a block
+// that isn't sealed yet get a placeholder phi, completed by sealBlock().
+//
+// Variables are numbered by the caller, one number per declaration, so that
+// a declaration hiding another one of the same name is a different variable.
+using SsaVariable = uint32_t;
+
+class SsaBuilder {
+public:
+    // `variable` holds `value` from here to the end of `block` (or the next write).
+    void writeVariable(SsaVariable variable, llvm::BasicBlock* block, llvm::Value* value);
+
+    // The value `variable` (of type `type`) holds at the current end of
+    // `block`. Poison if no path into the block assigns it.
+    llvm::Value* readVariable(SsaVariable variable, llvm::Type* type, llvm::BasicBlock* block);
+
+    // Declares that `block` won't get any more predecessors.
+    void sealBlock(llvm::BasicBlock* block);
+
+    // Forgets everything, after a function is done.
+    void clear();
+
+private:
+    llvm::Value* readVariableRecursive(SsaVariable variable, llvm::Type* type, llvm::BasicBlock* block);
+    llvm::Value* addPhiOperands(SsaVariable variable, llvm::PHINode* phi);
+    llvm::Value* tryRemoveTrivialPhi(llvm::PHINode* phi);
+
+    // (block, variable) -> its value at the end of the block. The handles
+    // follow a phi that is replaced by the value it turned out to merge.
+    llvm::DenseMap<std::pair<llvm::BasicBlock*, SsaVariable>, llvm::WeakTrackingVH> m_definitions;
+    llvm::SmallPtrSet<llvm::BasicBlock*, 16> m_sealed;
+    llvm::DenseMap<llvm::BasicBlock*, llvm::SmallVector<std::pair<SsaVariable, llvm::PHINode*>, 4>> m_incomplete_phis;
+};
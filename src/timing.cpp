@@ -0,0 +1,216 @@
+#include "timing.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sys/resource.h>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Passes shorter than this are left out of the trace, which otherwise gets
+// huge on big modules. The same default as clang's -ftime-trace-granularity.
+static constexpr unsigned kTraceGranularityUs = 500;
+
+uint64_t peakRssBytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss); // Already in bytes
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // In kilobytes
+#endif
+}
+
+TimeReport::TimeReport(const CompileOptions& options)
+    : m_time_report(options.timeReport), m_trace_file(options.traceFile) {
+    if (m_time_report) {
+        // What -time-passes sets: both pass managers now time every pass.
+        llvm::TimePassesIsEnabled = true;
+    }
+    if (!m_trace_file.empty()) {
+        llvm::timeTraceProfilerInitialize(kTraceGranularityUs, "ac");
+    }
+
+    // Right after the profiler starts, so our timestamps line up with its own.
+    m_start = std::chrono::steady_clock::now();
+}
+
+TimeReport::~TimeReport() {
+    if (llvm::timeTraceProfilerEnabled()) {
+        llvm::timeTraceProfilerCleanup();
+    }
+}
+
+double TimeReport::elapsedUs() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+TimeReport::Phase::Phase(TimeReport& report, const char* name, const std::string& detail)
+    : m_report(report), m_name(name), m_start_us(report.elapsedUs()), m_trace_scope(name, detail) {}
+
+TimeReport::Phase::~Phase() {
+    m_report.endPhase(m_name, m_start_us);
+}
+
+void TimeReport::endPhase(const char* name, double startUs) {
+    double endUs = elapsedUs();
+    uint64_t rss = peakRssBytes();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rss_samples.push_back(RssSample{endUs, rss});
+    for (PhaseRecord& record : m_phases) {
+        if (record.name == name) {
+            record.durationUs += endUs - startUs;
+            record.peakRssBytes = std::max(record.peakRssBytes, rss);
+            return;
+        }
+    }
+    m_phases.push_back(PhaseRecord{name, endUs - startUs, rss});
+}
+
+TimeReport::ThreadScope::ThreadScope(const TimeReport& report) : m_tracing(!report.m_trace_file.empty()) {
+    // LLVM's profiler keeps one recording per thread.
+    if (m_tracing) {
+        llvm::timeTraceProfilerInitialize(kTraceGranularityUs, "ac");
+    }
+}
+
+TimeReport::ThreadScope::~ThreadScope() {
+    // Hands this thread's recording over to be written by timeTraceProfilerWrite.
+    if (m_tracing) {
+        llvm::timeTraceProfilerFinishThread();
+    }
+}
+
+void TimeReport::addCounter(const std::string& name, uint64_t value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& counter : m_counters) {
+        if (counter.first == name) {
+            counter.second += value;
+            return;
+        }
+    }
+    m_counters.emplace_back(name, value);
+}
+
+bool TimeReport::finish() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_time_report) {
+        print();
+    }
+    if (!m_trace_file.empty()) {
+        return writeTrace();
+    }
+    return true;
+}
+
+void TimeReport::print() {
+    // The backend passes ran under the legacy pass manager, which keeps its
+    // timers until they are reported. (The optimization pipeline's table was
+    // already printed by CodeGen::optimize.) Everything goes through std::cout
+    // so it can't get interleaved with the rest of our output.
+    std::string passTimes;
+    llvm::raw_string_ostream passStream(passTimes);
+    llvm::reportAndResetTimings(&passStream);
+    std::cout << passStream.str();
+
+    double totalUs = 0;
+    for (const PhaseRecord& phase : m_phases) {
+        totalUs += phase.durationUs;
+    }
+
+    std::cout << "===" << std::string(73, '-') << "===\n"
+              << std::string(27, ' ') << "Atheria compile-time report\n"
+              << "===" << std::string(73, '-') << "===\n";
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  " << std::left << std::setw(28) << "Phase" << std::right
+              << std::setw(14) << "Wall (ms)" << std::setw(10) << "%"
+              << std::setw(18) << "Peak RSS (MB)" << "\n";
+    for (const PhaseRecord& phase : m_phases) {
+        double percent = totalUs > 0 ? 100.0 * phase.durationUs / totalUs : 0.0;
+        std::cout << "  " << std::left << std::setw(28) << phase.name << std::right
+                  << std::setw(14) << phase.durationUs / 1000.0
+                  << std::setw(9) << std::setprecision(1) << percent << "%"
+                  << std::setw(18) << std::setprecision(1) << phase.peakRssBytes / 1e6
+                  << std::setprecision(3) << "\n";
+    }
+    std::cout << "  " << std::left << std::setw(28) << "Total" << std::right
+              << std::setw(14) << totalUs / 1000.0 << "\n";
+    // Less than the total when files were compiled in parallel.
+    std::cout << "  " << std::left << std::setw(28) << "Wall clock" << std::right
+              << std::setw(14) << elapsedUs() / 1000.0 << "\n";
+
+    if (!m_counters.empty()) {
+        std::cout << "\n  " << std::left << std::setw(28) << "Counter" << std::right
+                  << std::setw(14) << "Value" << "\n";
+        for (const auto& [name, value] : m_counters) {
+            std::cout << "  " << std::left << std::setw(28) << name << std::right
+                      << std::setw(14) << value << "\n";
+        }
+    }
+    std::cout << std::defaultfloat << std::flush;
+}
+
+bool TimeReport::writeTrace() {
+    // LLVM's profiler serializes what it recorded: our phases and the passes...
+    llvm::SmallString<0> buffer;
+    llvm::raw_svector_ostream stream(buffer);
+    llvm::timeTraceProfilerWrite(stream);
+
+    llvm::Expected<llvm::json::Value> trace = llvm::json::parse(buffer);
+    if (!trace) {
+        std::cerr << "Error: Could not read back the time trace: "
+                  << llvm::toString(trace.takeError()) << std::endl;
+        return false;
+    }
+    llvm::json::Object* root = trace->getAsObject();
+    llvm::json::Array* events = root ? root->getArray("traceEvents") : nullptr;
+    if (!events) {
+        std::cerr << "Error: The time trace has no 'traceEvents' array" << std::endl;
+        return false;
+    }
+
+    // ...then we add a counter track with the memory use at the end of each phase...
+    int64_t pid = llvm::sys::Process::getProcessId();
+    for (const RssSample& sample : m_rss_samples) {
+        events->push_back(llvm::json::Object{
+            {"ph", "C"},
+            {"pid", pid},
+            {"name", "Peak RSS"},
+            {"ts", sample.timeUs},
+            {"args", llvm::json::Object{{"MB", sample.bytes / 1e6}}},
+        });
+    }
+
+    // ...and one global instant event that carries the counters.
+    llvm::json::Object counters;
+    for (const auto& [name, value] : m_counters) {
+        counters[name] = static_cast<int64_t>(value);
+    }
+    events->push_back(llvm::json::Object{
+        {"ph", "i"},
+        {"s", "g"},
+        {"pid", pid},
+        {"tid", 0},
+        {"name", "Counters"},
+        {"ts", elapsedUs()},
+        {"args", std::move(counters)},
+    });
+
+    std::error_code ec;
+    llvm::raw_fd_ostream out(m_trace_file, ec, llvm::sys::fs::OF_Text);
+    if (ec) {
+        std::cerr << "Error: Could not write trace file '" << m_trace_file << "': " << ec.message() << std::endl;
+        return false;
+    }
+    out << *trace;
+    return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "options.hpp"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/TimeProfiler.h"
+
+// --- Compile-Time Instrumentation ---
+// Records where a compilation spends its time and memory: the wall time of
+// each phase, the peak RSS at the end of it, and a few size counters.
+//
+//   --time-report   prints a table of all of this to stdout, after LLVM's own
+//                   per-pass timing tables.
+//   --trace=<file>  writes a Chrome trace (chrome://tracing, ui.perfetto.dev).
+//                   LLVM's TimeTraceProfiler records our phases and every
+//                   optimization and codegen pass; we add a memory counter
+//                   track and the counters on top.
+//
+// When several files are compiled, each phase's time and each counter is the
+// sum over all of them; the trace shows every file's phases on the thread
+// that compiled it. All members may be called from any thread.
+class TimeReport {
+public:
+    // Switches on LLVM's pass timers and time-trace profiler as requested.
+    TimeReport(const CompileOptions& options);
+    ~TimeReport();
+
+    TimeReport(const TimeReport&) = delete;
+    TimeReport& operator=(const TimeReport&) = delete;
+
+    // Whether anything is going to be reported. Counters that take real work
+    // to compute (walking the whole module, ...) should only be set when it is.
+    bool enabled() const { return m_time_report || !m_trace_file.empty(); }
+
+    // Marks one phase of the compilation for as long as it is alive. The
+    // detail (usually the file name) shows up in the trace.
+    class Phase {
+    public:
+        Phase(TimeReport& report, const char* name, const std::string& detail);
+        ~Phase();
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        TimeReport& m_report;
+        const char* m_name;
+        double m_start_us;
+        llvm::TimeTraceScope m_trace_scope; // Shows the phase in the trace, around its passes
+    };
+
+    // Every thread other than the one that created the TimeReport must hold
+    // one of these while it compiles, so LLVM's profiler records it as well.
+    class ThreadScope {
+    public:
+        ThreadScope(const TimeReport& report);
+        ~ThreadScope();
+
+        ThreadScope(const ThreadScope&) = delete;
+        ThreadScope& operator=(const ThreadScope&) = delete;
+
+    private:
+        bool m_tracing;
+    };
+
+    // Adds to a counter. Counters are reported in the order they were first added to.
+    void addCounter(const std::string& name, uint64_t value);
+
+    // Writes the --time-report table and/or the --trace file, whichever were
+    // requested. Returns false (after printing why) if the trace can't be written.
+    bool finish();
+
+private:
+    struct PhaseRecord {
+        std::string name;
+        double durationUs = 0;     // Summed over all files
+        uint64_t peakRssBytes = 0; // Of the whole process, at the end of the phase
+    };
+
+    // The peak RSS at some point in time, for the trace's memory track.
+    struct RssSample {
+        double timeUs;
+        uint64_t bytes;
+    };
+
+    double elapsedUs() const;
+    void endPhase(const char* name, double startUs);
+    void print();
+    bool writeTrace();
+
+    bool m_time_report;
+    std::string m_trace_file;
+    std::chrono::steady_clock::time_point m_start;
+
+    std::mutex m_mutex; // Guards everything below
+    std::vector<PhaseRecord> m_phases;
+    std::vector<RssSample> m_rss_samples;
+    std::vector<std::pair<std::string, uint64_t>> m_counters;
+};
+
+// The process's peak resident set size so far, in bytes.
+uint64_t peakRssBytes();
@@ -20,11 +20,14 @@ std::string tokenTypeToString(TokenType type) {
         case TokenType::RETURN:    return "RETURN";
         case TokenType::COMMA:    return "COMMA";
         case TokenType::AUTO:    return "AUTO";
+        case TokenType::CONSTEXPR:    return "CONSTEXPR";
+        case TokenType::EXPORT:    return "EXPORT";
+        case TokenType::STATIC:    return "STATIC";
         default:                        return "UNKNOWN";
     }
 }
 
-void Token::print() const {
-    std::cout << "Token( " << tokenTypeToString(type) 
-              << ", \"" << value << "\" )" << std::endl;
+void Token::print(std::string_view source) const {
+    std::cout << "Token( " << tokenTypeToString(type)
+              << ", \"" << text(source) << "\", " << line << ":" << column << " )" << std::endl;
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once // Prevents the file from being included multiple times
 
+#include <cstdint>
 #include <string>
-#include <vector>
+#include <string_view>
+#include "interner.hpp"
 
 // The different kinds of tokens our language recognizes.
-enum class TokenType {
+enum class TokenType : uint8_t {
     // Single-character tokens
     LEFT_PAREN, RIGHT_PAREN,
     LEFT_BRACE, RIGHT_BRACE,
@@ -24,6 +26,9 @@ enum class TokenType {
     // Keywords
     RETURN,     // The 'return' keyword
     AUTO,
+    CONSTEXPR,
+    EXPORT,
+    STATIC,
 
     // Special
     END_OF_FILE,
@@ -34,11 +39,20 @@ enum class TokenType {
 // This is incredibly useful for debugging!
 std::string tokenTypeToString(TokenType type);
 
-// Our Token struct
+// Our Token struct. A token doesn't own any text: it is a small plain record
+// that remembers where its text is in the source buffer, so tokens are cheap
+// to copy and their positions can be reported in diagnostics.
 struct Token {
-    TokenType type;
-    std::string value; // The actual text of the token, e.g., "print"
+    TokenType type = TokenType::UNKNOWN;
+    uint32_t offset = 0; // Where the token's text starts in the source
+    uint32_t length = 0; // For string literals the span covers just the contents, without quotes
+    uint32_t line = 0;   // Where the token starts, 1-based
+    uint32_t column = 0;
+    Symbol symbol = kNoSymbol; // The interned name, for identifiers and keywords
+
+    // The actual text of the token, e.g., "print"
+    std::string_view text(std::string_view source) const { return source.substr(offset, length); }
 
     // A handy method for debugging
-    void print() const;
+    void print(std::string_view source) const;
 };
\ No newline at end of file